@@ -1,61 +1,215 @@
-/* conv_simplified.c
-   Usage examples:
-     ./conv_test -f f.txt -g g.txt            # read inputs, print output to stdout
-     ./conv_test -f f.txt -g g.txt -o out.txt # write output to out.txt
-     ./conv_test -H 1000 -W 1000 -kH 3 -kW 3  # generate random inputs
-     ./conv_test -H 100 -W 200 -kH 4 -kW 4 -f f.txt -g g.txt -o out.txt
-*/
+/* conv.c - libconv: array file I/O, the convolution engines and the
+   plan/execute interface declared in conv.h. conv_test.c is the command-line
+   client. */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <getopt.h>
-#include <time.h>
-
-/* Read an array file into a flat buffer. File format:
-   H W\n
-   row0\n
-   row1\n
-   ... */
-int read_array_flat(const char *filename, float **out_buf, int *out_H, int *out_W) {
-    FILE *fp = fopen(filename, "r");
-    if (!fp) return -1;
-    if (fscanf(fp, "%d %d", out_H, out_W) != 2) { fclose(fp); return -2; }
-    int H = *out_H, W = *out_W;
-    if (H <= 0 || W <= 0) { fclose(fp); return -3; }
-    size_t n = (size_t)H * W;
+#include <errno.h>
+#include <math.h>
+#include <omp.h>
+
+#include "conv.h"
+
+const char conv_array_magic[4] = { 'C', 'O', 'N', 'V' };
+const char conv_volume_magic[4] = { 'C', 'N', 'V', '3' };
+
+/* n elements of the given storage type from fp, as floats */
+static int read_payload(FILE *fp, uint32_t type, size_t n, float **out_buf) {
     float *buf = malloc(sizeof(float) * n);
-    if (!buf) { fclose(fp); return -4; }
-    for (int i = 0; i < H; ++i) {
-        for (int j = 0; j < W; ++j) {
-            if (fscanf(fp, "%f", &buf[i*(size_t)W + j]) != 1) {
-                free(buf); fclose(fp); return -5;
-            }
-        }
+    if (!buf) return -4;
+    if (type == CONV_STORAGE_F32) {
+        if (fread(buf, sizeof(float), n, fp) != n) { free(buf); return -5; }
+    } else {
+        uint16_t *raw = malloc(sizeof(uint16_t) * n);
+        if (!raw) { free(buf); return -4; }
+        if (fread(raw, sizeof(uint16_t), n, fp) != n) { free(raw); free(buf); return -5; }
+        conv_half_to_float(type, raw, buf, n);
+        free(raw);
     }
-    fclose(fp);
     *out_buf = buf;
     return 0;
 }
 
-/* Write flat buffer to file with 3 decimal places (no trailing space at line end) */
-int write_array_flat(const char *filename, const float *buf, int H, int W) {
-    FILE *fp = fopen(filename, "w");
+/* Read an array or volume file into a flat buffer. Text format:
+   H W\n            or    D H W\n
+   row0\n                 D planes of H rows each, planes
+   row1\n                 separated by blank lines
+   ...
+   with "D H W" alone on its line. A 2D file reads as a volume with D = 1.
+   Binary files (see conv_array_header and conv_volume_header) are detected and read
+   as well. */
+int conv_read_volume_flat(const char *filename, float **out_buf, int *out_D, int *out_H, int *out_W) {
+    FILE *fp = fopen(filename, "rb");
     if (!fp) return -1;
-    fprintf(fp, "%d %d\n", H, W);
-    for (int i = 0; i < H; ++i) {
+    conv_volume_header hdr = { { 0 }, 0, 1, 0, 0 };
+    int rc;
+    if (fread(hdr.magic, sizeof(hdr.magic), 1, fp) == 1 && memcmp(hdr.magic, conv_array_magic, sizeof(conv_array_magic)) == 0) {
+        conv_array_header h2;
+        rc = fread(&h2.type, sizeof(h2) - sizeof(h2.magic), 1, fp) == 1 ? 0 : -2;
+        hdr.type = h2.type;
+        hdr.H = h2.H;
+        hdr.W = h2.W;
+    } else if (memcmp(hdr.magic, conv_volume_magic, sizeof(conv_volume_magic)) == 0) {
+        rc = fread(&hdr.type, sizeof(hdr) - sizeof(hdr.magic), 1, fp) == 1 ? 0 : -2;
+    } else {
+        /* text: the sizes and values are read token by token, as they
+           always were for 2D files. A third integer is W of a volume only
+           if it ends the line of the first two and exactly D*H*W values
+           follow; otherwise it is the first value of an H x W array. */
+        int dims[3], c, third = 0;
+        rewind(fp);
+        if (fscanf(fp, "%d %d", &dims[0], &dims[1]) != 2) { fclose(fp); return -2; }
+        while ((c = getc(fp)) == ' ' || c == '\t') { }
+        int line_ended = (c == '\n' || c == '\r' || c == EOF);
+        if (c != EOF) ungetc(c, fp);
+
+        size_t count = 0, cap = 1024;
+        float *buf = malloc(sizeof(float) * cap), v;
+        if (!buf) { fclose(fp); return -4; }
+        if (!line_ended && fscanf(fp, "%f", &v) == 1) {
+            buf[count++] = v;
+            while ((c = getc(fp)) == ' ' || c == '\t') { }
+            if ((c == '\n' || c == '\r' || c == EOF) && v >= 1 && v < 1e9f && v == (int)v) {
+                dims[2] = (int)v;
+                third = 1;
+            }
+            if (c != EOF) ungetc(c, fp);
+        }
+        while (fscanf(fp, "%f", &v) == 1) {
+            if (count == cap) {
+                float *grown = realloc(buf, sizeof(float) * cap * 2);
+                if (!grown) { free(buf); fclose(fp); return -4; }
+                buf = grown;
+                cap *= 2;
+            }
+            buf[count++] = v;
+        }
+        fclose(fp);
+
+        if (dims[0] <= 0 || dims[1] <= 0) { free(buf); return -3; }
+        size_t n2 = (size_t)dims[0] * dims[1];
+        if (third && count == n2 * dims[2] + 1) {
+            hdr.D = dims[0]; hdr.H = dims[1]; hdr.W = dims[2];
+            memmove(buf, buf + 1, sizeof(float) * (count - 1));
+        } else if (count >= n2) {
+            hdr.H = dims[0]; hdr.W = dims[1];
+        } else {
+            free(buf); return -5;
+        }
+        *out_D = hdr.D;
+        *out_H = hdr.H;
+        *out_W = hdr.W;
+        *out_buf = buf;
+        return 0;
+    }
+    if (rc == 0 && (hdr.D <= 0 || hdr.H <= 0 || hdr.W <= 0 || hdr.type > CONV_STORAGE_BF16)) rc = -3;
+    if (rc == 0) rc = read_payload(fp, hdr.type, (size_t)hdr.D * hdr.H * hdr.W, out_buf);
+    fclose(fp);
+    if (rc == 0) {
+        *out_D = hdr.D;
+        *out_H = hdr.H;
+        *out_W = hdr.W;
+    }
+    return rc;
+}
+
+/* Read a 2D array file into a flat buffer; volumes of more than one plane are rejected */
+int conv_read_array_flat(const char *filename, float **out_buf, int *out_H, int *out_W) {
+    int D;
+    int rc = conv_read_volume_flat(filename, out_buf, &D, out_H, out_W);
+    if (rc == 0 && D != 1) { free(*out_buf); return -3; }
+    return rc;
+}
+
+static void write_rows(FILE *fp, const float *buf, int rows, int W) {
+    for (int i = 0; i < rows; ++i) {
         for (int j = 0; j < W; ++j) {
             if (j) fprintf(fp, " ");
             fprintf(fp, "%.3f", buf[i*(size_t)W + j]);
         }
         fprintf(fp, "\n");
     }
+}
+
+/* Write flat buffer to file with 3 decimal places (no trailing space at line end) */
+int conv_write_array_flat(const char *filename, const float *buf, int H, int W) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) return -1;
+    fprintf(fp, "%d %d\n", H, W);
+    write_rows(fp, buf, H, W);
+    fclose(fp);
+    return 0;
+}
+
+/* Volume as text, planes separated by blank lines; one plane is written as 2D */
+int conv_write_volume_flat(const char *filename, const float *buf, int D, int H, int W) {
+    if (D == 1) return conv_write_array_flat(filename, buf, H, W);
+    FILE *fp = fopen(filename, "w");
+    if (!fp) return -1;
+    fprintf(fp, "%d %d %d\n", D, H, W);
+    for (int d = 0; d < D; ++d) {
+        if (d) fprintf(fp, "\n");
+        write_rows(fp, &buf[(size_t)d * H * W], H, W);
+    }
     fclose(fp);
     return 0;
 }
 
+/* n floats to fp, converted to the storage type */
+static int write_payload(FILE *fp, const float *buf, size_t n, conv_storage_type type) {
+    if (type == CONV_STORAGE_F32) return fwrite(buf, sizeof(float), n, fp) == n;
+    uint16_t *raw = malloc(sizeof(uint16_t) * n);
+    int ok = raw != NULL;
+    if (ok) {
+        conv_half_from_float(type, buf, raw, n);
+        ok = fwrite(raw, sizeof(uint16_t), n, fp) == n;
+    }
+    free(raw);
+    return ok;
+}
+
+/* Write flat buffer as a binary array file, converted to the storage type */
+int conv_write_array_binary(const char *filename, const float *buf, int H, int W, conv_storage_type type) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return -1;
+    conv_array_header hdr = { { 0 }, type, H, W };
+    memcpy(hdr.magic, conv_array_magic, sizeof(conv_array_magic));
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && write_payload(fp, buf, (size_t)H * W, type);
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -2;
+}
+
+/* Binary volume file; one plane is written as a 2D array file */
+int conv_write_volume_binary(const char *filename, const float *buf, int D, int H, int W, conv_storage_type type) {
+    if (D == 1) return conv_write_array_binary(filename, buf, H, W, type);
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return -1;
+    conv_volume_header hdr = { { 0 }, type, D, H, W };
+    memcpy(hdr.magic, conv_volume_magic, sizeof(conv_volume_magic));
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && write_payload(fp, buf, (size_t)D * H * W, type);
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -2;
+}
+
+static int is_binary_name(const char *filename) {
+    size_t len = strlen(filename);
+    return len >= 4 && strcmp(filename + len - 4, ".bin") == 0;
+}
+
+/* Text or binary by file name: "*.bin" is binary in the given storage type */
+int conv_write_array(const char *filename, const float *buf, int H, int W, conv_storage_type type) {
+    if (is_binary_name(filename)) return conv_write_array_binary(filename, buf, H, W, type);
+    return conv_write_array_flat(filename, buf, H, W);
+}
+
+int conv_write_volume(const char *filename, const float *buf, int D, int H, int W, conv_storage_type type) {
+    if (is_binary_name(filename)) return conv_write_volume_binary(filename, buf, D, H, W, type);
+    return conv_write_volume_flat(filename, buf, D, H, W);
+}
+
 /* allocate double-pointer (rows allocated individually) and copy from flat buffer */
-float **alloc_doubleptr_from_flat(const float *flat, int H, int W) {
+float **conv_alloc_doubleptr_from_flat(const float *flat, int H, int W) {
     float **arr = malloc(sizeof(float*) * H);
     if (!arr) return NULL;
     for (int i = 0; i < H; ++i) {
@@ -71,7 +225,7 @@ float **alloc_doubleptr_from_flat(const float *flat, int H, int W) {
     return arr;
 }
 
-void free_doubleptr(float **arr, int H) {
+void conv_free_doubleptr(float **arr, int H) {
     if (!arr) return;
     for (int i = 0; i < H; ++i) free(arr[i]);
     free(arr);
@@ -106,157 +260,681 @@ void conv2d_naive(double **f, int H, int W, double **g, int kH, int kW, double *
     }
 }
 
-/* Helper to convert float buffers (float) to double-pointer of doubles for computation precision */
-double **alloc_doubleptr_from_float_flat(const float *flat, int H, int W) {
-    double **arr = malloc(sizeof(double*) * H);
-    if (!arr) return NULL;
-    for (int i = 0; i < H; ++i) {
-        arr[i] = malloc(sizeof(double) * W);
-        if (!arr[i]) { for (int k=0;k<i;++k) free(arr[k]); free(arr); return NULL; }
-        for (int j = 0; j < W; ++j) arr[i][j] = flat[i*(size_t)W + j];
+/* Temporally blocked conv2d: applies g T times, equivalent to T calls of
+   conv2d_naive ping-ponging between two images, but advances several steps
+   on one cache-sized tile before moving on (overlapped tiling).
+
+   Each output tile loads its input with a halo of depth*centre_r rows above,
+   depth*(kH-1-centre_r) below and likewise for columns. Step t recomputes the
+   tile plus whatever halo the remaining steps still need, so the valid
+   region shrinks by one kernel footprint per step; halo cells are computed
+   redundantly by neighbouring tiles instead of being exchanged. The halo
+   grows with the depth, so one sweep advances at most TEMPORAL_HALO /
+   (k - 1) steps and T is run as several sweeps through full images. Taps
+   outside the image are skipped exactly as in conv2d_naive, and the taps
+   are summed in the same order, so the result is bit-identical to the
+   naive passes. */
+#define TEMPORAL_TILE 128
+#define TEMPORAL_HALO 32   /* halo rows (and columns) one sweep may add to a tile */
+
+/* Steps per sweep: as many as keep the halo within TEMPORAL_HALO, at least 1 */
+static int temporal_depth(int kH, int kW, int T) {
+    int reach = kH > kW ? kH - 1 : kW - 1;
+    int depth = reach > 0 ? TEMPORAL_HALO / reach : T;
+    if (depth < 1) depth = 1;
+    return depth < T ? depth : T;
+}
+
+/* Doubles of scratch one thread needs for a sweep of depth steps: two local
+   regions of the largest size, tile plus the full halo, clipped to the image */
+static size_t temporal_region_size(int H, int W, int kH, int kW, int depth) {
+    size_t rows = TEMPORAL_TILE + (size_t)depth * (kH - 1);
+    size_t cols = TEMPORAL_TILE + (size_t)depth * (kW - 1);
+    return 2 * (rows < (size_t)H ? rows : (size_t)H) * (cols < (size_t)W ? cols : (size_t)W);
+}
+
+/* Bytes a tiled run reads (tile plus halo) and writes, over all sweeps, for reporting */
+size_t conv2d_temporal_traffic(int H, int W, int kH, int kW, int T) {
+    int cr = (kH - 1) / 2, cc = (kW - 1) / 2;
+    int depth = temporal_depth(kH, kW, T);
+    size_t bytes = 0;
+    for (int done = 0; done < T; done += depth) {
+        int steps = T - done < depth ? T - done : depth;
+        bytes += (size_t)H * W * sizeof(double);
+        for (int r0 = 0; r0 < H; r0 += TEMPORAL_TILE) {
+            int r1 = r0 + TEMPORAL_TILE < H ? r0 + TEMPORAL_TILE : H;
+            int lr0 = r0 - steps*cr > 0 ? r0 - steps*cr : 0;
+            int lr1 = r1 + steps*(kH-1-cr) < H ? r1 + steps*(kH-1-cr) : H;
+            for (int c0 = 0; c0 < W; c0 += TEMPORAL_TILE) {
+                int c1 = c0 + TEMPORAL_TILE < W ? c0 + TEMPORAL_TILE : W;
+                int lc0 = c0 - steps*cc > 0 ? c0 - steps*cc : 0;
+                int lc1 = c1 + steps*(kW-1-cc) < W ? c1 + steps*(kW-1-cc) : W;
+                bytes += (size_t)(lr1 - lr0) * (lc1 - lc0) * sizeof(double);
+            }
+        }
     }
-    return arr;
+    return bytes;
+}
+
+/* Doubles of scratch for threads threads: their regions, plus the image
+   between sweeps (row pointers first, as alloc_rows) when there is more
+   than one sweep */
+size_t conv2d_temporal_scratch_size(int H, int W, int kH, int kW, int T, int threads) {
+    int depth = temporal_depth(kH, kW, T);
+    size_t image = depth < T ? (size_t)H + (size_t)H * W : 0;
+    return image + (size_t)threads * temporal_region_size(H, W, kH, kW, depth);
+}
+
+/* One sweep: T steps from src into dst, tile by tile */
+static void temporal_sweep(double **src, int H, int W, double **g, int kH, int kW, int T,
+                           double *regions, size_t per_thread, int threads, double **dst) {
+    int centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    int below = kH - 1 - centre_r, right = kW - 1 - centre_c;
+    int tiles_r = (H + TEMPORAL_TILE - 1) / TEMPORAL_TILE;
+    int tiles_c = (W + TEMPORAL_TILE - 1) / TEMPORAL_TILE;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        double *cur = &regions[per_thread * omp_get_thread_num()];
+        double *nxt = cur + per_thread / 2;
+
+        #pragma omp for collapse(2) schedule(dynamic)
+        for (int tr = 0; tr < tiles_r; ++tr) {
+            for (int tc = 0; tc < tiles_c; ++tc) {
+                int r0 = tr * TEMPORAL_TILE, r1 = r0 + TEMPORAL_TILE < H ? r0 + TEMPORAL_TILE : H;
+                int c0 = tc * TEMPORAL_TILE, c1 = c0 + TEMPORAL_TILE < W ? c0 + TEMPORAL_TILE : W;
+
+                /* local region = tile + full halo, clipped to the image */
+                int lr0 = r0 - T*centre_r > 0 ? r0 - T*centre_r : 0;
+                int lr1 = r1 + T*below < H ? r1 + T*below : H;
+                int lc0 = c0 - T*centre_c > 0 ? c0 - T*centre_c : 0;
+                int lc1 = c1 + T*right < W ? c1 + T*right : W;
+                int ld = lc1 - lc0;
+
+                for (int i = lr0; i < lr1; ++i)
+                    memcpy(&cur[(size_t)(i - lr0) * ld], &src[i][lc0], sizeof(double) * ld);
+
+                for (int t = 1; t <= T; ++t) {
+                    /* region still needed by the remaining T - t steps */
+                    int ar0 = r0 - (T-t)*centre_r > 0 ? r0 - (T-t)*centre_r : 0;
+                    int ar1 = r1 + (T-t)*below < H ? r1 + (T-t)*below : H;
+                    int ac0 = c0 - (T-t)*centre_c > 0 ? c0 - (T-t)*centre_c : 0;
+                    int ac1 = c1 + (T-t)*right < W ? c1 + (T-t)*right : W;
+
+                    for (int i = ar0; i < ar1; ++i) {
+                        /* taps that stay inside the image, same ones conv2d_naive keeps */
+                        int ki0 = centre_r - i > 0 ? centre_r - i : 0;
+                        int ki1 = H - i + centre_r < kH ? H - i + centre_r : kH;
+                        for (int j = ac0; j < ac1; ++j) {
+                            int kj0 = centre_c - j > 0 ? centre_c - j : 0;
+                            int kj1 = W - j + centre_c < kW ? W - j + centre_c : kW;
+                            double sum = 0.0;
+                            for (int ki = ki0; ki < ki1; ++ki) {
+                                const double *row = &cur[(size_t)(i + ki - centre_r - lr0) * ld + (j - centre_c - lc0)];
+                                for (int kj = kj0; kj < kj1; ++kj)
+                                    sum += row[kj] * g[ki][kj];
+                            }
+                            if (t == T) dst[i][j] = sum;
+                            else nxt[(size_t)(i - lr0) * ld + (j - lc0)] = sum;
+                        }
+                    }
+                    double *tmp = cur; cur = nxt; nxt = tmp;
+                }
+            }
+        }
+    }
+}
+
+void conv2d_temporal_scratch(double **f, int H, int W, double **g, int kH, int kW, int T,
+                             double *scratch, int threads, double **out) {
+    int depth = temporal_depth(kH, kW, T);
+    int sweeps = (T + depth - 1) / depth;
+    double **image = NULL;
+    double *regions = scratch;
+    if (sweeps > 1) {
+        image = (double **)scratch;
+        for (int i = 0; i < H; ++i) image[i] = &scratch[H + (size_t)i * W];
+        regions = &scratch[H + (size_t)H * W];
+    }
+
+    /* choose the first destination so that the last sweep lands in out */
+    double **src = f;
+    double **dst = (sweeps % 2) ? out : image;
+    for (int done = 0; done < T; done += depth) {
+        int steps = T - done < depth ? T - done : depth;
+        temporal_sweep(src, H, W, g, kH, kW, steps, regions, temporal_region_size(H, W, kH, kW, depth), threads, dst);
+        src = dst;
+        dst = (dst == out) ? image : out;
+    }
+}
+
+int conv2d_temporal(double **f, int H, int W, double **g, int kH, int kW, int T, double **out) {
+    int threads = omp_get_max_threads();
+    double *scratch = malloc(sizeof(double) * conv2d_temporal_scratch_size(H, W, kH, kW, T, threads));
+    if (!scratch) return -1;
+    conv2d_temporal_scratch(f, H, W, g, kH, kW, T, scratch, threads, out);
+    free(scratch);
+    return 0;
 }
 
-void free_doubleptr_double(double **arr, int H) { if (!arr) return; for (int i=0;i<H;++i) free(arr[i]); free(arr); }
-
-/* Main program: parse args, read or generate, run conv, print/write output */
-int main(int argc, char **argv) {
-    char *file_f = NULL, *file_g = NULL, *file_o = NULL;
-    int H=0,W=0,kH=0,kW=0;
-    int print_stdout = 1;
-
-    struct option long_options[] = {
-        {"kH", required_argument, 0, 0},
-        {"kW", required_argument, 0, 0},
-        {0, 0, 0, 0} // terminator
-    };
-
-    int option_index = 0;
-    int c;
-
-    while ((c = getopt_long(argc, argv, "f:g:o:H:W:hp", long_options, &option_index)) != -1) {
-        switch (c) {
-            case 0: // long option
-                if (strcmp(long_options[option_index].name, "kH") == 0) kH = atoi(optarg);
-                if (strcmp(long_options[option_index].name, "kW") == 0) kW = atoi(optarg);
-                break;
-            case 'f': file_f = strdup(optarg); break;
-            case 'g': file_g = strdup(optarg); break;
-            case 'o': file_o = strdup(optarg); break;
-            case 'H': H = atoi(optarg); break;
-            case 'W': W = atoi(optarg); break;
-            case 'p': print_stdout = 1; break;
-            case 'h':
-            default:
-                fprintf(stderr, "Usage: %s ...\n", argv[0]);
-                return 1;
+/* Summed-area-table conv2d for constant kernels (box / mean filters).
+   With every tap equal to c, out(i,j) = c * (sum of f over the part of the
+   kernel window that lies inside the image), and any window sum is four
+   lookups in the integral image S, where S[i][j] = sum of f[0..i-1][0..j-1].
+   The window is clipped exactly as conv2d_naive clips taps, so zero padding
+   and the even-kernel centre are preserved, at O(1) cost per pixel.
+
+   S is built in double with Kahan-compensated prefix sums (rows in parallel,
+   then column blocks in parallel), so corner differences on large images
+   keep close to full double precision. Close is not exact: unlike the other
+   engines the result is not bit-identical to conv2d_naive, and one inf or
+   NaN in f reaches every S entry below and to the right of it, so it spoils
+   those outputs instead of only the windows that contain it. */
+#define SAT_MIN_TAPS 9      /* below this the naive loop is as cheap */
+#define SAT_COL_BLOCK 256   /* columns per parallel block in the vertical pass */
+
+int conv_kernel_is_constant(double **g, int kH, int kW, double *value) {
+    for (int ki = 0; ki < kH; ++ki)
+        for (int kj = 0; kj < kW; ++kj)
+            if (g[ki][kj] != g[0][0]) return 0;
+    *value = g[0][0];
+    return 1;
+}
+
+void conv2d_sat_scratch(double **f, int H, int W, double c, int kH, int kW, double *S, double **out) {
+    size_t ld = (size_t)W + 1;
+    memset(S, 0, sizeof(double) * ld);
+
+    /* horizontal prefix sums, compensated */
+    #pragma omp parallel for
+    for (int i = 0; i < H; ++i) {
+        double *row = &S[(i + 1) * ld];
+        double sum = 0.0, comp = 0.0;
+        row[0] = 0.0;
+        for (int j = 0; j < W; ++j) {
+            double y = f[i][j] - comp;
+            double t = sum + y;
+            comp = (t - sum) - y;
+            sum = t;
+            row[j + 1] = sum;
         }
     }
 
-    float *f_flat = NULL, *g_flat = NULL;
-    int fH=0,fW=0,gH=0,gW=0;
+    /* vertical prefix sums, one compensation term per column */
+    #pragma omp parallel for
+    for (int jb = 1; jb <= W; jb += SAT_COL_BLOCK) {
+        int je = jb + SAT_COL_BLOCK <= W + 1 ? jb + SAT_COL_BLOCK : W + 1;
+        double comp[SAT_COL_BLOCK] = {0};
+        for (int i = 2; i <= H; ++i) {
+            const double *above = &S[(i - 1) * ld];
+            double *row = &S[i * ld];
+            for (int j = jb; j < je; ++j) {
+                double y = row[j] - comp[j - jb];
+                double t = above[j] + y;
+                comp[j - jb] = (t - above[j]) - y;
+                row[j] = t;
+            }
+        }
+    }
 
-    int generate_random = (H>0 && W>0 && kH>0 && kW>0);
+    int centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    #pragma omp parallel for
+    for (int i = 0; i < H; ++i) {
+        int r0 = i - centre_r > 0 ? i - centre_r : 0;
+        int r1 = i - centre_r + kH < H ? i - centre_r + kH : H;
+        const double *top = &S[r0 * ld], *bottom = &S[r1 * ld];
+        for (int j = 0; j < W; ++j) {
+            int c0 = j - centre_c > 0 ? j - centre_c : 0;
+            int c1 = j - centre_c + kW < W ? j - centre_c + kW : W;
+            out[i][j] = c * ((bottom[c1] - bottom[c0]) - (top[c1] - top[c0]));
+        }
+    }
+}
 
-    /* Only read f/g files if we're NOT generating random arrays,
-    or if the file already exists (optional). */
-    if (!generate_random && file_f) {
-        if (read_array_flat(file_f, &f_flat, &fH, &fW) != 0) { 
-            fprintf(stderr, "Failed to read f file\n"); 
-            return 1; 
+int conv2d_sat(double **f, int H, int W, double c, int kH, int kW, double **out) {
+    double *S = malloc(sizeof(double) * (H + 1) * ((size_t)W + 1));
+    if (!S) return -1;
+    conv2d_sat_scratch(f, H, W, c, kH, kW, S, out);
+    free(S);
+    return 0;
+}
+
+/* Sparse-kernel conv2d: g is compiled once into the list of its nonzero taps
+   as (dy, dx, w) offsets from the centre, and each output row accumulates one
+   tap at a time over the whole row, a unit-stride loop that vectorises. Each
+   pixel still receives its taps in row-major kernel order, and the skipped
+   taps are zeros or outside the image, so the sums match conv2d_naive. */
+#define SPARSE_MAX_DENSITY 0.5 /* auto picks sparse below this fraction of nonzero taps */
+
+/* Returns the number of nonzero taps written to *taps (caller frees), or -1 */
+int conv_compile_sparse_kernel(double **g, int kH, int kW, conv_tap **taps) {
+    int centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    conv_tap *t = malloc(sizeof(conv_tap) * (size_t)kH * kW);
+    if (!t) return -1;
+    int n = 0;
+    for (int ki = 0; ki < kH; ++ki)
+        for (int kj = 0; kj < kW; ++kj)
+            if (g[ki][kj] != 0.0) {
+                t[n].dy = ki - centre_r;
+                t[n].dx = kj - centre_c;
+                t[n].w = g[ki][kj];
+                n++;
+            }
+    *taps = t;
+    return n;
+}
+
+void conv2d_sparse(double **f, int H, int W, const conv_tap *taps, int num_taps, double **out) {
+    #pragma omp parallel for
+    for (int i = 0; i < H; ++i) {
+        double *dst = out[i];
+        memset(dst, 0, sizeof(double) * W);
+        for (int t = 0; t < num_taps; ++t) {
+            int src_i = i + taps[t].dy;
+            if (src_i < 0 || src_i >= H) continue;
+            int dx = taps[t].dx;
+            int j0 = dx < 0 ? -dx : 0;
+            int j1 = dx > 0 ? W - dx : W;
+            const double *src = f[src_i];
+            double w = taps[t].w;
+            #pragma omp simd
+            for (int j = j0; j < j1; ++j)
+                dst[j] += src[j + dx] * w;
         }
     }
-    if (!generate_random && file_g) {
-        if (read_array_flat(file_g, &g_flat, &gH, &gW) != 0) { 
-            fprintf(stderr, "Failed to read g file\n"); 
-            return 1; 
+}
+
+/* conv2d on 16-bit storage: f and out are flat H*W arrays of fp16 or bf16,
+   g is a flat float kernel, and every sum is accumulated in float registers.
+   Taps and zero padding are those of conv2d_naive. Per output row block, each
+   input row segment (block plus halo) is widened into a float scratch row
+   once and reused by all kW taps of that kernel row, and the float sums are
+   narrowed once on store, so conversion cost is per pixel, not per tap,
+   while the image in memory stays at 2 bytes per pixel. */
+#define HALF_COL_BLOCK 1024 /* output columns per block; scratch stays in L1 */
+
+int conv2d_half(conv_storage_type type, const uint16_t *f, int H, int W, const float *g, int kH, int kW, uint16_t *out) {
+    int centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    int blocks = (W + HALF_COL_BLOCK - 1) / HALF_COL_BLOCK;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float *row = malloc(sizeof(float) * (HALF_COL_BLOCK + kW - 1));
+        float *acc = malloc(sizeof(float) * HALF_COL_BLOCK);
+        if (!row || !acc) {
+            #pragma omp atomic write
+            failed = 1;
         }
+
+        #pragma omp for collapse(2)
+        for (int i = 0; i < H; ++i) {
+            for (int b = 0; b < blocks; ++b) {
+                if (!row || !acc) continue;
+                int c0 = b * HALF_COL_BLOCK, c1 = c0 + HALF_COL_BLOCK < W ? c0 + HALF_COL_BLOCK : W;
+                int n = c1 - c0;
+                /* input columns [lo, hi) feed this block; clip to the image */
+                int lo = c0 - centre_c, hi = c1 + (kW - 1 - centre_c);
+                int a0 = lo > 0 ? lo : 0, a1 = hi < W ? hi : W;
+
+                for (int j = 0; j < n; ++j) acc[j] = 0.0f;
+                for (int ki = 0; ki < kH; ++ki) {
+                    int src_i = i + ki - centre_r;
+                    if (src_i < 0 || src_i >= H) continue;
+                    for (int j = lo; j < a0; ++j) row[j - lo] = 0.0f;
+                    conv_half_to_float(type, &f[(size_t)src_i * W + a0], &row[a0 - lo], a1 - a0);
+                    for (int j = a1; j < hi; ++j) row[j - lo] = 0.0f;
+                    for (int kj = 0; kj < kW; ++kj) {
+                        float w = g[(size_t)ki * kW + kj];
+                        const float *src = &row[kj];
+                        #pragma omp simd
+                        for (int j = 0; j < n; ++j) acc[j] += w * src[j];
+                    }
+                }
+                conv_half_from_float(type, acc, &out[(size_t)i * W + c0], n);
+            }
+        }
+        free(row);
+        free(acc);
     }
+    return failed ? -1 : 0;
+}
 
-    if (!f_flat && !(H>0 && W>0)) { fprintf(stderr, "Either provide -f or -H and -W\n"); return 1; }
-    if (!g_flat && !(kH>0 && kW>0)) { fprintf(stderr, "Either provide -g or -kH and -kW\n"); return 1; }
-
-    if (!f_flat) {
-        fH = H; fW = W;
-        printf("H = %d\n", H);
-        printf("W = %d\n", W);
-        f_flat = malloc(sizeof(float)*(size_t)H*W);
-        if (!f_flat) { perror("malloc"); return 1; }
-        srand(1234);
-        for (size_t i=0;i<(size_t)H*W;++i) f_flat[i] = (float)rand()/RAND_MAX;
-
-        /* save to file if requested */
-        if (file_f) {
-            if (write_array_flat(file_f, f_flat, fH, fW) != 0) {
-                fprintf(stderr, "Failed to write generated f file\n");
-                return 1;
+/* conv2d on 8-bit images: f and out are uint8 codes with their own
+   conv_quant_params, k is the fixed-point kernel, products are summed exactly in
+   int32 and each pixel is requantised once. Every input row segment is copied
+   into a scratch row padded with f's zero point, the code for 0.0, so the
+   SIMD row kernels never test borders; since sum q*(x - zp) = sum q*x - zp *
+   sum q, the zero point is taken out once per kernel row used. Rows outside
+   the image are skipped as in conv2d_naive. Requantisation rounds halves up. */
+#define QUANT_COL_BLOCK 1024 /* output columns per block */
+
+int conv2d_u8(const uint8_t *f, int H, int W, conv_quant_params fq, const conv_quant_kernel *k, conv_quant_params oq, uint8_t *out) {
+    int kH = k->kH, kW = k->kW;
+    int centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    int blocks = (W + QUANT_COL_BLOCK - 1) / QUANT_COL_BLOCK;
+    float m = fq.scale * k->scale / oq.scale;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        uint8_t *row = malloc(QUANT_COL_BLOCK + kW - 1 + CONV_QUANT_ROW_SLACK);
+        int32_t *acc = malloc(sizeof(int32_t) * QUANT_COL_BLOCK);
+        if (!row || !acc) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for collapse(2)
+        for (int i = 0; i < H; ++i) {
+            for (int b = 0; b < blocks; ++b) {
+                if (!row || !acc) continue;
+                int c0 = b * QUANT_COL_BLOCK, c1 = c0 + QUANT_COL_BLOCK < W ? c0 + QUANT_COL_BLOCK : W;
+                int n = c1 - c0;
+                int lo = c0 - centre_c, hi = c1 + (kW - 1 - centre_c);
+                int a0 = lo > 0 ? lo : 0, a1 = hi < W ? hi : W;
+
+                memset(acc, 0, sizeof(int32_t) * n);
+                int64_t zero_sum = 0;
+                for (int ki = 0; ki < kH; ++ki) {
+                    int src_i = i + ki - centre_r;
+                    if (src_i < 0 || src_i >= H) continue;
+                    memset(row, fq.zero_point, a0 - lo);
+                    memcpy(&row[a0 - lo], &f[(size_t)src_i * W + a0], a1 - a0);
+                    memset(&row[a1 - lo], fq.zero_point, hi - a1 + CONV_QUANT_ROW_SLACK);
+                    quant_row_accumulate(k, ki, row, acc, n);
+                    zero_sum += k->row_sum[ki];
+                }
+                int64_t corr = fq.zero_point * zero_sum;
+                uint8_t *dst = &out[(size_t)i * W + c0];
+                for (int j = 0; j < n; ++j) {
+                    float v = oq.zero_point + (float)(acc[j] - corr) * m;
+                    v = v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+                    dst[j] = (uint8_t)(v + 0.5f);
+                }
             }
         }
+        free(row);
+        free(acc);
     }
+    return failed ? -1 : 0;
+}
 
-    if (!g_flat) {
-        gH = kH; gW = kW;
-        g_flat = malloc(sizeof(float)*(size_t)kH*kW);
-        if (!g_flat) { perror("malloc"); return 1; }
-        srand(5678);
-        for (size_t i=0;i<(size_t)kH*kW;++i) g_flat[i] = (float)rand()/RAND_MAX;
-
-        /* save to file if requested */
-        if (file_g) {
-            if (write_array_flat(file_g, g_flat, gH, gW) != 0) {
-                fprintf(stderr, "Failed to write generated g file\n");
-                return 1;
+/* conv3d: D x H x W volumes and kD x kH x kW kernels, flat and row-major
+   (plane, row, column), with conv2d_naive's centre and zero padding along
+   all three axes:
+     out(d,i,j) = sum of f(d + kd - centre_d, i + ki - centre_r, j + kj - centre_c) * g(kd,ki,kj)
+   over the taps that land inside the volume, in kd, ki, kj order. */
+void conv3d_naive(const double *f, int D, int H, int W, const double *g, int kD, int kH, int kW, double *out) {
+    int centre_d = (kD - 1) / 2, centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+
+    /* planes in parallel, so that blocking is what conv3d_blocked is measured against */
+    #pragma omp parallel for
+    for (int d = 0; d < D; ++d) {
+        for (int i = 0; i < H; ++i) {
+            for (int j = 0; j < W; ++j) {
+                double sum = 0.0;
+                for (int kd = 0; kd < kD; ++kd) {
+                    int src_d = d + (kd - centre_d);
+                    if (src_d < 0 || src_d >= D) continue;
+                    for (int ki = 0; ki < kH; ++ki) {
+                        int src_i = i + (ki - centre_r);
+                        if (src_i < 0 || src_i >= H) continue;
+                        for (int kj = 0; kj < kW; ++kj) {
+                            int src_j = j + (kj - centre_c);
+                            if (src_j < 0 || src_j >= W) continue;
+                            sum += f[((size_t)src_d * H + src_i) * W + src_j] * g[((size_t)kd * kH + ki) * kW + kj];
+                        }
+                    }
+                }
+                out[((size_t)d * H + i) * W + j] = sum;
             }
         }
     }
+}
+
+/* Blocked conv3d. The volume is cut into tiles of CONV3D_DEPTH_BLOCK planes
+   by CONV3D_TILE_H rows by CONV3D_TILE_W columns, handed out to threads.
+   A tile walks down its planes keeping only the kD input planes the current
+   output plane needs, each cut to the tile plus its halo, in a ring: every
+   step loads one new plane into the slot of the one that dropped out, so
+   each input plane is read once per tile (plus kD - 1 priming planes per
+   depth block) while all kD*kH*kW taps reuse it from cache.
+
+   Columns outside the image are zeros in the ring, so the row loops need no
+   tests; planes and rows outside are skipped as in conv3d_naive. Taps are
+   summed in the same order and adding the padding's zero products leaves a
+   sum unchanged, so the result is bit-identical to conv3d_naive for finite
+   input. */
+#define CONV3D_DEPTH_BLOCK 16
+#define CONV3D_TILE_H 16
+#define CONV3D_TILE_W 256
+
+size_t conv3d_blocked_resident(int kD, int kH, int kW) {
+    return sizeof(double) * kD * (CONV3D_TILE_H + (size_t)kH - 1) * (CONV3D_TILE_W + (size_t)kW - 1);
+}
+
+int conv3d_blocked(const double *f, int D, int H, int W, const double *g, int kD, int kH, int kW, double *out) {
+    int centre_d = (kD - 1) / 2, centre_r = (kH - 1) / 2, centre_c = (kW - 1) / 2;
+    int tiles_d = (D + CONV3D_DEPTH_BLOCK - 1) / CONV3D_DEPTH_BLOCK;
+    int tiles_r = (H + CONV3D_TILE_H - 1) / CONV3D_TILE_H;
+    int tiles_c = (W + CONV3D_TILE_W - 1) / CONV3D_TILE_W;
+    size_t ld = CONV3D_TILE_W + (size_t)kW - 1;
+    size_t slot = (CONV3D_TILE_H + (size_t)kH - 1) * ld;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        double *ring = malloc(conv3d_blocked_resident(kD, kH, kW));
+        if (!ring) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for collapse(3) schedule(dynamic)
+        for (int td = 0; td < tiles_d; ++td) {
+            for (int tr = 0; tr < tiles_r; ++tr) {
+                for (int tc = 0; tc < tiles_c; ++tc) {
+                    if (!ring) continue;
+                    int d0 = td * CONV3D_DEPTH_BLOCK, d1 = d0 + CONV3D_DEPTH_BLOCK < D ? d0 + CONV3D_DEPTH_BLOCK : D;
+                    int r0 = tr * CONV3D_TILE_H, r1 = r0 + CONV3D_TILE_H < H ? r0 + CONV3D_TILE_H : H;
+                    int c0 = tc * CONV3D_TILE_W, c1 = c0 + CONV3D_TILE_W < W ? c0 + CONV3D_TILE_W : W;
+                    int n = c1 - c0;
+                    /* ring row lr, column lc hold image row r0 - centre_r + lr, column c0 - centre_c + lc */
+                    int rows = r1 - r0 + kH - 1, cols = n + kW - 1;
+                    int a0 = c0 - centre_c > 0 ? c0 - centre_c : 0;
+                    int a1 = c1 + (kW - 1 - centre_c) < W ? c1 + (kW - 1 - centre_c) : W;
+
+                    for (int p = d0 - centre_d; p < d1 - centre_d + kD - 1; ++p) {
+                        /* plane p enters the ring when output plane p + centre_d - kD + 1 starts */
+                        int d = p + centre_d - (kD - 1);
+                        if (p >= 0 && p < D) {
+                            double *dst = &ring[(size_t)(p % kD) * slot];
+                            for (int lr = 0; lr < rows; ++lr) {
+                                int si = r0 - centre_r + lr;
+                                if (si < 0 || si >= H) continue;
+                                double *row = &dst[(size_t)lr * ld];
+                                const double *src = &f[((size_t)p * H + si) * W];
+                                for (int lc = 0; lc < a0 - (c0 - centre_c); ++lc) row[lc] = 0.0;
+                                memcpy(&row[a0 - (c0 - centre_c)], &src[a0], sizeof(double) * (a1 - a0));
+                                for (int lc = a1 - (c0 - centre_c); lc < cols; ++lc) row[lc] = 0.0;
+                            }
+                        }
+                        if (d < d0) continue; /* still priming */
+
+                        for (int i = r0; i < r1; ++i) {
+                            double acc[CONV3D_TILE_W];
+                            for (int j = 0; j < n; ++j) acc[j] = 0.0;
+                            for (int kd = 0; kd < kD; ++kd) {
+                                int src_d = d + kd - centre_d;
+                                if (src_d < 0 || src_d >= D) continue;
+                                const double *plane = &ring[(size_t)(src_d % kD) * slot];
+                                for (int ki = 0; ki < kH; ++ki) {
+                                    int src_i = i + ki - centre_r;
+                                    if (src_i < 0 || src_i >= H) continue;
+                                    const double *row = &plane[(size_t)(i - r0 + ki) * ld];
+                                    const double *w = &g[((size_t)kd * kH + ki) * kW];
+                                    for (int kj = 0; kj < kW; ++kj) {
+                                        double wk = w[kj];
+                                        #pragma omp simd
+                                        for (int j = 0; j < n; ++j) acc[j] += row[j + kj] * wk;
+                                    }
+                                }
+                            }
+                            memcpy(&out[((size_t)d * H + i) * W + c0], acc, sizeof(double) * n);
+                        }
+                    }
+                }
+            }
+        }
+        free(ring);
+    }
+    return failed ? -1 : 0;
+}
+
+/* Helper to convert float buffers (float) to double-pointer of doubles for computation precision */
+double **conv_alloc_doubleptr_from_float_flat(const float *flat, int H, int W) {
+    double **arr = malloc(sizeof(double*) * H);
+    if (!arr) return NULL;
+    for (int i = 0; i < H; ++i) {
+        arr[i] = malloc(sizeof(double) * W);
+        if (!arr[i]) { for (int k=0;k<i;++k) free(arr[k]); free(arr); return NULL; }
+        for (int j = 0; j < W; ++j) arr[i][j] = flat[i*(size_t)W + j];
+    }
+    return arr;
+}
 
-    /* final dims */
-    if (f_flat) { /* already set fH,fW */ }
-    if (g_flat) { /* already set gH,gW */ }
+void conv_free_doubleptr_double(double **arr, int H) { if (!arr) return; for (int i=0;i<H;++i) free(arr[i]); free(arr); }
 
-    /* Kernel must not be bigger than image */
-    if (gH > fH || gW > fW) { fprintf(stderr, "Kernel must not be larger than image (got f %dx%d, g %dx%d)\n", fH, fW, gH, gW); return 1; }
+const char *const conv_engine_names[] = { "auto", "naive", "sat", "sparse", "temporal" };
 
-    /* convert to double-pointer double for conv computations */
-    double **f_dp = alloc_doubleptr_from_float_flat(f_flat, fH, fW);
-    double **g_dp = alloc_doubleptr_from_float_flat(g_flat, gH, gW);
-    if (!f_dp || !g_dp) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+/* Fastest engine for this kernel: sat for large constant kernels, which is
+   approximate (see conv2d_sat), else sparse or naive, which are exact */
+static conv_engine choose_engine(conv_engine requested, double **g, int kH, int kW, int num_taps) {
+    double c;
+    if (requested != CONV_ENGINE_AUTO) return requested;
+    if (kH * kW >= SAT_MIN_TAPS && conv_kernel_is_constant(g, kH, kW, &c)) return CONV_ENGINE_SAT;
+    if (num_taps < SPARSE_MAX_DENSITY * kH * kW) return CONV_ENGINE_SPARSE;
+    return CONV_ENGINE_NAIVE;
+}
 
-    double **out_dp = malloc(sizeof(double*) * fH);
-    for (int i = 0; i < fH; ++i) { out_dp[i] = malloc(sizeof(double) * fW); for (int j=0;j<fW;++j) out_dp[i][j] = 0.0; }
+/* ---- plans ---- */
+
+struct conv_plan {
+    int H, W, kH, kW, iters;
+    conv_engine engine;
+    double **g;
+    double c;              /* the tap value, sat */
+    conv_tap *taps;
+    int num_taps;
+    double **f, **out;     /* the image and the result in double */
+    double *scratch;       /* summed-area table (sat) or per-thread regions (temporal) */
+    int threads;           /* temporal: threads the scratch is sized for */
+};
+
+/* H rows of W doubles in one block, row pointers first */
+static double **alloc_rows(int H, int W) {
+    double **rows = malloc(sizeof(double *) * H + sizeof(double) * (size_t)H * W);
+    if (!rows) return NULL;
+    double *data = (double *)(rows + H);
+    for (int i = 0; i < H; ++i) rows[i] = &data[(size_t)i * W];
+    return rows;
+}
 
-    /* perform convolution (timed) */
-    clock_t t0 = clock();
-    conv2d_naive(f_dp, fH, fW, g_dp, gH, gW, out_dp);
-    clock_t t1 = clock();
-    double elapsed = (double)(t1 - t0) / CLOCKS_PER_SEC;
+conv_options conv_default_options(void) {
+    conv_options opts = { CONV_ENGINE_AUTO, 1 };
+    return opts;
+}
 
-    /* convert output to float flat for writing */
-    float *out_flat = malloc(sizeof(float)*(size_t)fH*fW);
-    for (int i = 0; i < fH; ++i) for (int j = 0; j < fW; ++j) out_flat[i*(size_t)fW + j] = (float)out_dp[i][j];
+static conv_plan *plan_fail(conv_plan *p, int err) {
+    conv_plan_destroy(p);
+    errno = err;
+    return NULL;
+}
 
-    if (file_o) {
-        if (write_array_flat(file_o, out_flat, fH, fW) != 0) fprintf(stderr, "Failed to write output\n");
+conv_plan *conv_plan_create(int H, int W, const float *g, int kH, int kW, const conv_options *opts) {
+    conv_options o = opts ? *opts : conv_default_options();
+    if (H <= 0 || W <= 0 || kH <= 0 || kW <= 0 || o.iters < 1 ||
+        (o.iters > 1 && o.engine != CONV_ENGINE_AUTO && o.engine != CONV_ENGINE_TEMPORAL)) {
+        errno = EINVAL;
+        return NULL;
     }
+    conv_plan *p = calloc(1, sizeof(*p));
+    if (!p) return plan_fail(NULL, ENOMEM);
+    p->H = H;
+    p->W = W;
+    p->kH = kH;
+    p->kW = kW;
+    p->iters = o.iters;
+    p->g = conv_alloc_doubleptr_from_float_flat(g, kH, kW);
+    p->num_taps = p->g ? conv_compile_sparse_kernel(p->g, kH, kW, &p->taps) : -1;
+    if (p->num_taps < 0) return plan_fail(p, ENOMEM);
+
+    p->engine = o.iters > 1 ? CONV_ENGINE_TEMPORAL : choose_engine(o.engine, p->g, kH, kW, p->num_taps);
+    if (p->engine == CONV_ENGINE_SAT && !conv_kernel_is_constant(p->g, kH, kW, &p->c)) return plan_fail(p, EINVAL);
+
+    p->f = alloc_rows(H, W);
+    p->out = alloc_rows(H, W);
+    if (!p->f || !p->out) return plan_fail(p, ENOMEM);
+    if (p->engine == CONV_ENGINE_SAT) {
+        p->scratch = malloc(sizeof(double) * (H + 1) * ((size_t)W + 1));
+        if (!p->scratch) return plan_fail(p, ENOMEM);
+    } else if (p->engine == CONV_ENGINE_TEMPORAL) {
+        p->threads = omp_get_max_threads();
+        p->scratch = malloc(sizeof(double) * conv2d_temporal_scratch_size(H, W, kH, kW, p->iters, p->threads));
+        if (!p->scratch) return plan_fail(p, ENOMEM);
+    }
+    return p;
+}
 
-    if (print_stdout) {
-        printf("%d %d\n", fH, fW);
-        for (int i = 0; i < fH; ++i) {
-            for (int j = 0; j < fW; ++j) {
-                if (j) printf(" ");
-                printf("%.3f", out_flat[i*(size_t)fW + j]);
-            }
-            printf("\n");
+void conv_execute(conv_plan *p, const float *in, float *out) {
+    int H = p->H, W = p->W;
+    int nonfinite = 0;
+    #pragma omp parallel for reduction(|:nonfinite)
+    for (int i = 0; i < H; ++i)
+        for (int j = 0; j < W; ++j) {
+            p->f[i][j] = in[(size_t)i * W + j];
+            nonfinite |= !isfinite(p->f[i][j]);
         }
+
+    /* a summed-area table would smear inf or NaN over the rest of the image */
+    conv_engine engine = p->engine;
+    if (engine == CONV_ENGINE_SAT && nonfinite) engine = CONV_ENGINE_NAIVE;
+
+    switch (engine) {
+    case CONV_ENGINE_SAT:
+        conv2d_sat_scratch(p->f, H, W, p->c, p->kH, p->kW, p->scratch, p->out);
+        break;
+    case CONV_ENGINE_SPARSE:
+        conv2d_sparse(p->f, H, W, p->taps, p->num_taps, p->out);
+        break;
+    case CONV_ENGINE_TEMPORAL:
+        conv2d_temporal_scratch(p->f, H, W, p->g, p->kH, p->kW, p->iters, p->scratch, p->threads, p->out);
+        break;
+    default:
+        conv2d_naive(p->f, H, W, p->g, p->kH, p->kW, p->out);
+        break;
     }
 
-    fprintf(stderr, "Time: %.6f s\n", elapsed);
+    #pragma omp parallel for
+    for (int i = 0; i < H; ++i)
+        for (int j = 0; j < W; ++j) out[(size_t)i * W + j] = (float)p->out[i][j];
+}
 
-    /* cleanup */
-    free(f_flat); free(g_flat); free(out_flat);
-    free_doubleptr_double(f_dp, fH); free_doubleptr_double(g_dp, gH);
-    for (int i=0;i<fH;++i) free(out_dp[i]); free(out_dp);
-    if (file_f) free(file_f); if (file_g) free(file_g); if (file_o) free(file_o);
-    return 0;
+conv_engine conv_plan_engine(const conv_plan *p) {
+    return p->engine;
+}
+
+int conv_plan_taps(const conv_plan *p) {
+    return p->num_taps;
+}
+
+void conv_plan_destroy(conv_plan *p) {
+    if (!p) return;
+    conv_free_doubleptr_double(p->g, p->kH);
+    free(p->taps);
+    free(p->f);
+    free(p->out);
+    free(p->scratch);
+    free(p);
 }
@@ -0,0 +1,162 @@
+#ifndef CONV_H
+#define CONV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "half.h"
+#include "quant.h"
+#include "mconv.h"
+
+/* libconv: 2D convolution with zero padding and the centre rule of
+   conv2d_naive, as a static (libconv.a) or shared (libconv.so) library.
+
+   Most callers want a plan:
+
+     conv_options opts = conv_default_options();
+     conv_plan *p = conv_plan_create(H, W, g, kH, kW, &opts);
+     for (each image) conv_execute(p, in, out);
+     conv_plan_destroy(p);
+
+   conv_plan_create chooses the engine, prepares the kernel and allocates
+   every buffer the engine needs; conv_execute then runs on flat row-major
+   H*W float arrays without allocating. A plan may be executed from one
+   thread at a time (each execution is itself OpenMP-parallel); use one plan
+   per calling thread otherwise.
+
+   The engines and array file helpers below are the building blocks and can
+   also be called directly; multi-channel images are in mconv.h. */
+
+/* ---- array files ---- */
+
+/* Binary array file: this header, then H*W elements of the given storage
+   type, row-major, in host byte order. conv_read_array_flat recognises it by the
+   magic; output files whose names end in ".bin" are written in it. */
+typedef struct {
+    char magic[4];     /* "CONV" */
+    uint32_t type;     /* conv_storage_type */
+    int32_t H, W;
+} conv_array_header;
+
+extern const char conv_array_magic[4];
+
+/* Volumes of D planes use "CNV3" and this header, then D*H*W elements,
+   plane by plane. Text volumes start with a line of just "D H W" instead
+   of "H W", followed by exactly D*H*W values. */
+typedef struct {
+    char magic[4];     /* "CNV3" */
+    uint32_t type;     /* conv_storage_type */
+    int32_t D, H, W;
+} conv_volume_header;
+
+extern const char conv_volume_magic[4];
+
+/* Read a text or binary array file into a malloc'd flat float buffer.
+   Returns 0, or a negative code on open, format, size, memory or data
+   errors; conv_read_array_flat rejects volumes of more than one plane, and
+   conv_read_volume_flat reads 2D files as D = 1. */
+int conv_read_array_flat(const char *filename, float **out_buf, int *out_H, int *out_W);
+int conv_read_volume_flat(const char *filename, float **out_buf, int *out_D, int *out_H, int *out_W);
+
+/* Text with 3 decimal places */
+int conv_write_array_flat(const char *filename, const float *buf, int H, int W);
+
+/* Binary, converted to the storage type */
+int conv_write_array_binary(const char *filename, const float *buf, int H, int W, conv_storage_type type);
+
+/* Text or binary by file name: "*.bin" is binary in the given storage type */
+int conv_write_array(const char *filename, const float *buf, int H, int W, conv_storage_type type);
+
+/* Volume counterparts; a volume with D = 1 is written in the 2D formats */
+int conv_write_volume_flat(const char *filename, const float *buf, int D, int H, int W);
+int conv_write_volume_binary(const char *filename, const float *buf, int D, int H, int W, conv_storage_type type);
+int conv_write_volume(const char *filename, const float *buf, int D, int H, int W, conv_storage_type type);
+
+/* ---- double-pointer images (rows allocated individually) ---- */
+
+float **conv_alloc_doubleptr_from_flat(const float *flat, int H, int W);
+void conv_free_doubleptr(float **arr, int H);
+double **conv_alloc_doubleptr_from_float_flat(const float *flat, int H, int W);
+void conv_free_doubleptr_double(double **arr, int H);
+
+/* ---- engines ---- */
+
+void conv2d_naive(double **f, int H, int W, double **g, int kH, int kW, double **out);
+
+/* g applied T times, tiled in time; bit-identical to T naive passes.
+   conv2d_temporal allocates its scratch, conv2d_temporal_scratch uses
+   conv2d_temporal_scratch_size doubles from the caller and at most
+   threads OpenMP threads. */
+int conv2d_temporal(double **f, int H, int W, double **g, int kH, int kW, int T, double **out);
+size_t conv2d_temporal_scratch_size(int H, int W, int kH, int kW, int T, int threads);
+void conv2d_temporal_scratch(double **f, int H, int W, double **g, int kH, int kW, int T,
+                             double *scratch, int threads, double **out);
+size_t conv2d_temporal_traffic(int H, int W, int kH, int kW, int T);
+
+/* Constant kernel c via a summed-area table; conv2d_sat_scratch takes the
+   (H+1)*(W+1) doubles of the table from the caller. Approximate: it differs
+   from conv2d_naive by the rounding of the prefix sums, and an inf or NaN
+   in f spreads to every output below and to the right of it. */
+int conv_kernel_is_constant(double **g, int kH, int kW, double *value);
+int conv2d_sat(double **f, int H, int W, double c, int kH, int kW, double **out);
+void conv2d_sat_scratch(double **f, int H, int W, double c, int kH, int kW, double *S, double **out);
+
+/* Nonzero taps only */
+typedef struct {
+    int dy, dx;
+    double w;
+} conv_tap;
+
+int conv_compile_sparse_kernel(double **g, int kH, int kW, conv_tap **taps);
+void conv2d_sparse(double **f, int H, int W, const conv_tap *taps, int num_taps, double **out);
+
+/* 16-bit image storage with float accumulation */
+int conv2d_half(conv_storage_type type, const uint16_t *f, int H, int W, const float *g, int kH, int kW, uint16_t *out);
+
+/* uint8 images with a fixed-point kernel */
+int conv2d_u8(const uint8_t *f, int H, int W, conv_quant_params fq, const conv_quant_kernel *k, conv_quant_params oq, uint8_t *out);
+
+/* D x H x W volumes and kD x kH x kW kernels, flat (plane, row, column).
+   conv3d_blocked tiles all three axes, runs tiles in parallel and streams
+   each tile through depth with kD planes resident, a ring of
+   conv3d_blocked_resident bytes per thread; it matches conv3d_naive bit
+   for bit. Returns 0, or -1 on allocation failure. */
+void conv3d_naive(const double *f, int D, int H, int W, const double *g, int kD, int kH, int kW, double *out);
+int conv3d_blocked(const double *f, int D, int H, int W, const double *g, int kD, int kH, int kW, double *out);
+size_t conv3d_blocked_resident(int kD, int kH, int kW);
+
+/* ---- plans ---- */
+
+typedef enum { CONV_ENGINE_AUTO, CONV_ENGINE_NAIVE, CONV_ENGINE_SAT, CONV_ENGINE_SPARSE, CONV_ENGINE_TEMPORAL } conv_engine;
+extern const char *const conv_engine_names[]; /* "auto", "naive", "sat", "sparse", "temporal" */
+#define CONV_NUM_ENGINES 5
+
+typedef struct {
+    conv_engine engine; /* CONV_ENGINE_AUTO picks the fastest engine for the kernel: sat
+                           for large constant kernels, otherwise an exact one */
+    int iters;          /* apply the kernel this many times per execution (default 1) */
+} conv_options;
+
+typedef struct conv_plan conv_plan;
+
+conv_options conv_default_options(void);
+
+/* Plan for H x W images and the kH x kW float kernel g (copied). opts may
+   be NULL for the defaults; iters > 1 runs the temporal engine. The kernel
+   may be larger than the image: taps that fall outside it are skipped, as
+   everywhere else. Returns NULL with errno EINVAL for iters < 1, iters > 1
+   with another engine than auto or temporal, or the sat engine with a
+   non-constant kernel, and with ENOMEM on allocation failure. */
+conv_plan *conv_plan_create(int H, int W, const float *g, int kH, int kW, const conv_options *opts);
+
+/* out = g * in (iters times); in and out are H*W floats and may not overlap.
+   A sat plan runs naive for an image holding inf or NaN. */
+void conv_execute(conv_plan *plan, const float *in, float *out);
+
+/* Engine the plan runs, never CONV_ENGINE_AUTO; number of nonzero taps */
+conv_engine conv_plan_engine(const conv_plan *plan);
+int conv_plan_taps(const conv_plan *plan);
+
+void conv_plan_destroy(conv_plan *plan);
+
+#endif
@@ -0,0 +1,934 @@
+/* conv_test.c - command-line client of libconv (conv.h)
+   Usage examples:
+     ./conv_test -f f.txt -g g.txt            # read inputs, print output to stdout
+     ./conv_test -f f.txt -g g.txt -o out.txt # write output to out.txt
+     ./conv_test -H 1000 -W 1000 -kH 3 -kW 3  # generate random inputs
+     ./conv_test -H 100 -W 200 -kH 4 -kW 4 -f f.txt -g g.txt -o out.txt
+     ./conv_test -f f.txt -g g.txt --iters 8    # apply g 8 times (temporally blocked)
+     ./conv_test -f f.txt -g g.txt --engine sat # force an engine (auto, naive, sat, sparse, temporal)
+     ./conv_test -f f.txt -g g.txt --reps 10    # time 10 samples instead of one call, see time_call()
+     ./conv_test -f f.txt -g g.txt --storage fp16 -o out.bin # 16-bit image storage, binary output
+     ./conv_test -f f.txt -g g.txt --quant int8 # uint8 image, int8 kernel, int32 sums
+     ./conv_test -D 64 -H 256 -W 256 --kD 3 -kH 3 -kW 3 # 3D volume, see run_volume()
+     ./conv_test --serve /tmp/conv.sock         # long-running service, see serve()
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <signal.h>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "../common/bench.h"
+#include "../common/roofline.h"
+#include "conv.h"
+
+/* One timed call by default, so a run costs what it reports. --reps N, or
+   BENCH_OUTPUT for the full statistics, switches to bench_run sampling
+   with at least N samples. Returns 0, or -1 on allocation failure. */
+static int time_call(bench *bm, const char *name, void (*fn)(void *), void *arg, int reps, bench_stats *stats) {
+    const char *output = getenv("BENCH_OUTPUT");
+    if (reps <= 1 && !(output && *output)) {
+        bench_start(bm, name);
+        fn(arg);
+        *stats = bench_stop(bm);
+        return 0;
+    }
+    /* a short budget keeps the tool responsive */
+    bench_opts opts = bench_default_opts();
+    opts.min_samples = reps > 1 ? reps : 3;
+    opts.min_sample = 0.001;
+    opts.max_total = 0.1;
+    return bench_run(bm, name, fn, arg, &opts, stats);
+}
+
+/* bench_run wrappers; rc keeps the engine's own result */
+typedef struct {
+    conv_plan *plan;
+    const float *in;
+    float *out;
+} plan_args;
+
+static void run_conv_execute(void *p) {
+    plan_args *a = p;
+    conv_execute(a->plan, a->in, a->out);
+}
+
+typedef struct {
+    conv_storage_type type;
+    const uint16_t *f;
+    const float *g;
+    uint16_t *out;
+    int H, W, kH, kW;
+    int rc;
+} half_args;
+
+static void run_conv2d_half(void *p) {
+    half_args *a = p;
+    a->rc = conv2d_half(a->type, a->f, a->H, a->W, a->g, a->kH, a->kW, a->out);
+}
+
+typedef struct {
+    const uint8_t *f;
+    uint8_t *out;
+    int H, W;
+    conv_quant_params fq, oq;
+    const conv_quant_kernel *k;
+    int rc;
+} u8_args;
+
+static void run_conv2d_u8(void *p) {
+    u8_args *a = p;
+    a->rc = conv2d_u8(a->f, a->H, a->W, a->fq, a->k, a->oq, a->out);
+}
+
+/* T independent naive passes, ping-ponging through scratch; result in out */
+typedef struct {
+    double **f, **g, **out;
+    int H, W, kH, kW;
+    int T;
+    double **scratch;
+} iter_args;
+
+static void run_conv2d_naive_iters(void *p) {
+    iter_args *a = p;
+    double **src = a->f;
+    /* choose the first destination so that pass T lands in out */
+    double **dst = (a->T % 2) ? a->out : a->scratch;
+    for (int t = 0; t < a->T; ++t) {
+        conv2d_naive(src, a->H, a->W, a->g, a->kH, a->kW, dst);
+        src = dst;
+        dst = (dst == a->out) ? a->scratch : a->out;
+    }
+}
+
+/* Floating-point work of one plan execution on n pixels; naive counts
+   every tap, including the few that fall outside the image */
+static double plan_flops(const conv_plan *plan, size_t n, int kH, int kW, int iters) {
+    switch (conv_plan_engine(plan)) {
+        case CONV_ENGINE_SAT: return 7.0 * n; /* table entry: 3 adds, window: 3 adds and a multiply */
+        case CONV_ENGINE_SPARSE: return 2.0 * n * conv_plan_taps(plan);
+        default: return 2.0 * n * kH * kW * iters;
+    }
+}
+
+/* ---- service mode ----
+
+   conv_test --serve PATH listens on a UNIX domain socket (--serve - reads
+   stdin and answers on stdout) and runs one convolution per request line,
+   so callers pay process start-up, OpenMP team creation and planning once
+   instead of per image. Requests:
+
+     conv f=IN g=KERNEL o=OUT [engine=auto|naive|sat|sparse|temporal]
+         -> ok ENGINE H W SECONDS    or    error MESSAGE
+     stats
+         -> stats requests=N errors=N p50=S p90=S p99=S max=S plans=N hits=N misses=N
+            (the percentiles are over the N successful conv requests; errors
+            counts the conv requests answered with an error)
+     quit
+         -> bye (ends the connection, or the server in stdin mode)
+     shutdown
+         -> bye (stops the server)
+
+   IN, KERNEL and OUT are array files as for -f/-g/-o, or shm:NAME for a
+   POSIX shared-memory object holding a binary array (see conv_array_header).
+   Float inputs in shared memory are used in place. Outputs to shm:NAME are
+   created or resized by the server and written as float.
+
+   Plans are cached by an FNV-1a hash of the image shape, the requested
+   engine and the kernel. Each holds two double images, so the cache is
+   small and evicts the least recently used. Connections are served one at
+   a time, each by the same warm OpenMP team. */
+#define SERVE_MAX_PLANS 16
+#define SERVE_LINE 4096
+
+typedef struct {
+    uint64_t hash;
+    int H, W, kH, kW;
+    conv_engine engine;    /* as requested */
+    float *g;              /* the taps, to confirm a hash match */
+    conv_plan *plan;
+    unsigned long last_used;
+} cached_plan;
+
+typedef struct {
+    cached_plan plans[SERVE_MAX_PLANS];
+    int num_plans;
+    unsigned long clock, hits, misses;
+    unsigned long errors;  /* conv requests that failed */
+    double *latency;       /* seconds, one per successful request */
+    size_t num_latency, cap_latency;
+    float *out;            /* result buffer, grown as needed */
+    size_t cap_out;
+} serve_state;
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void free_cached_plan(cached_plan *p) {
+    free(p->g);
+    conv_plan_destroy(p->plan);
+    memset(p, 0, sizeof(*p));
+}
+
+/* Cached plan, or a new one replacing the least recently used; NULL with
+   errno set as by conv_plan_create */
+static conv_plan *get_plan(serve_state *s, int H, int W, const float *g, int kH, int kW, conv_engine engine) {
+    int key[5] = { H, W, kH, kW, engine };
+    size_t taps = (size_t)kH * kW;
+    uint64_t h = fnv1a(0xcbf29ce484222325ULL, key, sizeof(key));
+    h = fnv1a(h, g, sizeof(float) * taps);
+    s->clock++;
+    for (int i = 0; i < s->num_plans; ++i) {
+        cached_plan *p = &s->plans[i];
+        if (p->hash == h && p->H == H && p->W == W && p->kH == kH && p->kW == kW && p->engine == engine &&
+            memcmp(p->g, g, sizeof(float) * taps) == 0) {
+            p->last_used = s->clock;
+            s->hits++;
+            return p->plan;
+        }
+    }
+    s->misses++;
+    conv_options opts = conv_default_options();
+    opts.engine = engine;
+    float *copy = malloc(sizeof(float) * taps);
+    if (!copy) { errno = ENOMEM; return NULL; }
+    memcpy(copy, g, sizeof(float) * taps);
+    conv_plan *plan = conv_plan_create(H, W, g, kH, kW, &opts);
+    if (!plan) { free(copy); return NULL; }
+
+    cached_plan *p = &s->plans[0];
+    if (s->num_plans < SERVE_MAX_PLANS) p = &s->plans[s->num_plans++];
+    else {
+        for (int i = 1; i < s->num_plans; ++i)
+            if (s->plans[i].last_used < p->last_used) p = &s->plans[i];
+        free_cached_plan(p);
+    }
+    *p = (cached_plan){ h, H, W, kH, kW, engine, copy, plan, s->clock };
+    return plan;
+}
+
+/* A mapped or loaded array; data points into the mapping for float shm */
+typedef struct {
+    float *data;
+    int H, W;
+    void *map;
+    size_t map_len;
+    int owned;             /* data was malloc'd */
+} array_ref;
+
+static int load_array(const char *spec, array_ref *a) {
+    memset(a, 0, sizeof(*a));
+    if (strncmp(spec, "shm:", 4) != 0) {
+        a->owned = 1;
+        return conv_read_array_flat(spec, &a->data, &a->H, &a->W);
+    }
+    int fd = shm_open(spec + 4, O_RDONLY, 0);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(conv_array_header)) { close(fd); return -2; }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    a->map = map;
+    a->map_len = st.st_size;
+    const conv_array_header *hdr = map;
+    if (memcmp(hdr->magic, conv_array_magic, sizeof(conv_array_magic)) != 0 || hdr->H <= 0 || hdr->W <= 0 ||
+        hdr->type > CONV_STORAGE_BF16 ||
+        a->map_len < sizeof(*hdr) + (size_t)hdr->H * hdr->W * conv_storage_size(hdr->type)) return -3;
+    a->H = hdr->H;
+    a->W = hdr->W;
+    size_t n = (size_t)a->H * a->W;
+    if (hdr->type == CONV_STORAGE_F32) {
+        a->data = (float *)(hdr + 1);
+    } else {
+        a->data = malloc(sizeof(float) * n);
+        if (!a->data) return -4;
+        a->owned = 1;
+        conv_half_to_float(hdr->type, (const uint16_t *)(hdr + 1), a->data, n);
+    }
+    return 0;
+}
+
+static void release_array(array_ref *a) {
+    if (a->owned) free(a->data);
+    if (a->map) munmap(a->map, a->map_len);
+    memset(a, 0, sizeof(*a));
+}
+
+static int store_array(const char *spec, const float *buf, int H, int W) {
+    if (strncmp(spec, "shm:", 4) != 0) return conv_write_array(spec, buf, H, W, CONV_STORAGE_F32);
+    size_t len = sizeof(conv_array_header) + sizeof(float) * (size_t)H * W;
+    int fd = shm_open(spec + 4, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, len) != 0) { close(fd); return -1; }
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    /* invalidate an array already there, and publish the magic only after
+       the payload, so readers never take a half-written array for a whole one */
+    conv_array_header *hdr = map;
+    memset(hdr->magic, 0, sizeof(hdr->magic));
+    __sync_synchronize();
+    hdr->type = CONV_STORAGE_F32;
+    hdr->H = H;
+    hdr->W = W;
+    memcpy(hdr + 1, buf, sizeof(float) * (size_t)H * W);
+    __sync_synchronize();
+    memcpy(hdr->magic, conv_array_magic, sizeof(conv_array_magic));
+    munmap(map, len);
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void latency_stats(const serve_state *s, FILE *out) {
+    size_t n = s->num_latency;
+    double *sorted = malloc(sizeof(double) * (n ? n : 1));
+    if (!sorted) { fprintf(out, "error out of memory\n"); return; }
+    memcpy(sorted, s->latency, sizeof(double) * n);
+    qsort(sorted, n, sizeof(double), compare_double);
+    /* nearest-rank percentiles */
+    double p[3] = { 0.50, 0.90, 0.99 }, v[3] = { 0 };
+    for (int i = 0; i < 3; ++i)
+        if (n) v[i] = sorted[(size_t)ceil(p[i] * n) - 1];
+    fprintf(out, "stats requests=%zu errors=%lu p50=%.6f p90=%.6f p99=%.6f max=%.6f plans=%d hits=%lu misses=%lu\n",
+            n, s->errors, v[0], v[1], v[2], n ? sorted[n - 1] : 0.0, s->num_plans, s->hits, s->misses);
+    free(sorted);
+}
+
+/* One "conv" request. Returns NULL on success with the engine and shape
+   filled in, else the error message. */
+static const char *serve_conv(serve_state *s, char *args, conv_engine *used, int *H, int *W) {
+    char *f_spec = NULL, *g_spec = NULL, *o_spec = NULL;
+    conv_engine engine = CONV_ENGINE_AUTO;
+    for (char *tok = strtok(args, " \t"); tok; tok = strtok(NULL, " \t")) {
+        if (strncmp(tok, "f=", 2) == 0) f_spec = tok + 2;
+        else if (strncmp(tok, "g=", 2) == 0) g_spec = tok + 2;
+        else if (strncmp(tok, "o=", 2) == 0) o_spec = tok + 2;
+        else if (strncmp(tok, "engine=", 7) == 0) {
+            int found = 0;
+            for (int e = 0; e < CONV_NUM_ENGINES; ++e)
+                if (strcmp(tok + 7, conv_engine_names[e]) == 0) { engine = (conv_engine)e; found = 1; }
+            if (!found) return "unknown engine";
+        } else return "unknown argument";
+    }
+    if (!f_spec || !g_spec || !o_spec) return "conv needs f=, g= and o=";
+
+    array_ref f, g;
+    if (load_array(f_spec, &f) != 0) { release_array(&f); return "cannot read f"; }
+    if (load_array(g_spec, &g) != 0) { release_array(&f); release_array(&g); return "cannot read g"; }
+    const char *err = NULL;
+    size_t n = (size_t)f.H * f.W;
+    conv_plan *plan = NULL;
+    if (!(plan = get_plan(s, f.H, f.W, g.data, g.H, g.W, engine)))
+        err = errno == EINVAL ? "the sat engine needs a constant kernel" : "out of memory";
+    else if (s->cap_out < n) {
+        float *out = realloc(s->out, sizeof(float) * n);
+        if (out) { s->out = out; s->cap_out = n; }
+        else err = "out of memory";
+    }
+    if (!err) {
+        conv_execute(plan, f.data, s->out);
+        if (store_array(o_spec, s->out, f.H, f.W) != 0) err = "cannot write o";
+        *used = conv_plan_engine(plan);
+    }
+    *H = f.H;
+    *W = f.W;
+    release_array(&f);
+    release_array(&g);
+    return err;
+}
+
+/* Serve requests from in until quit, shutdown, EOF or a failed reply;
+   returns 1 on shutdown */
+static int serve_stream(serve_state *s, FILE *in, FILE *out) {
+    char line[SERVE_LINE];
+    while (fgets(line, sizeof(line), in)) {
+        double start = bench_wall();
+        line[strcspn(line, "\r\n")] = '\0';
+        char *cmd = line + strspn(line, " \t");
+        if (*cmd == '\0') continue;
+        if (strcmp(cmd, "quit") == 0 || strcmp(cmd, "shutdown") == 0) {
+            fprintf(out, "bye\n");
+            fflush(out);
+            return strcmp(cmd, "shutdown") == 0;
+        }
+        if (strcmp(cmd, "stats") == 0) {
+            latency_stats(s, out);
+        } else if (strncmp(cmd, "conv", 4) == 0 && (cmd[4] == ' ' || cmd[4] == '\0')) {
+            conv_engine used = CONV_ENGINE_AUTO;
+            int H = 0, W = 0;
+            const char *err = serve_conv(s, cmd + 4, &used, &H, &W);
+            double latency = bench_wall() - start;
+            if (err) {
+                fprintf(out, "error %s\n", err);
+                s->errors++;
+            } else {
+                fprintf(out, "ok %s %d %d %.6f\n", conv_engine_names[used], H, W, latency);
+                if (s->num_latency == s->cap_latency) {
+                    size_t cap = s->cap_latency ? 2 * s->cap_latency : 1024;
+                    double *l = realloc(s->latency, sizeof(double) * cap);
+                    if (l) { s->latency = l; s->cap_latency = cap; }
+                }
+                if (s->num_latency < s->cap_latency) s->latency[s->num_latency++] = latency;
+            }
+        } else {
+            fprintf(out, "error unknown request\n");
+        }
+        /* the client went away: this connection is over, the server is not */
+        if (fflush(out) != 0) return 0;
+    }
+    return 0;
+}
+
+static int serve(const char *path) {
+    serve_state s;
+    memset(&s, 0, sizeof(s));
+    /* start the OpenMP team now rather than on the first request */
+    #pragma omp parallel
+    { }
+
+    int rc = 0;
+    if (strcmp(path, "-") == 0) {
+        serve_stream(&s, stdin, stdout);
+    } else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(addr.sun_path)) { fprintf(stderr, "Socket path too long\n"); return 1; }
+        strcpy(addr.sun_path, path);
+        /* replace a stale socket from an earlier run, but never anything else */
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) { fprintf(stderr, "%s exists and is not a socket\n", path); return 1; }
+            unlink(path);
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+            perror(path);
+            if (fd >= 0) close(fd);
+            return 1;
+        }
+        /* a client that hangs up before reading its reply must not kill the
+           server; the write fails instead and ends that connection */
+        signal(SIGPIPE, SIG_IGN);
+        fprintf(stderr, "Serving on %s\n", path);
+        for (int done = 0; !done;) {
+            int conn = accept(fd, NULL, NULL);
+            if (conn < 0 && errno == EINTR) continue;
+            if (conn < 0) { perror("accept"); rc = 1; break; }
+            FILE *in = fdopen(conn, "r");
+            FILE *out = in ? fdopen(dup(conn), "w") : NULL;
+            if (!in || !out) { perror("fdopen"); if (in) fclose(in); else close(conn); continue; }
+            done = serve_stream(&s, in, out);
+            fclose(in);
+            fclose(out);
+        }
+        close(fd);
+        unlink(path);
+    }
+
+    latency_stats(&s, stderr);
+    for (int i = 0; i < s.num_plans; ++i) free_cached_plan(&s.plans[i]);
+    free(s.out);
+    free(s.latency);
+    return rc;
+}
+
+/* ---- volumes ---- */
+
+typedef struct {
+    const double *f, *g;
+    double *out;
+    int D, H, W, kD, kH, kW;
+    int rc;
+} vol_args;
+
+static void run_conv3d_naive(void *p) {
+    vol_args *a = p;
+    conv3d_naive(a->f, a->D, a->H, a->W, a->g, a->kD, a->kH, a->kW, a->out);
+}
+
+static void run_conv3d_blocked(void *p) {
+    vol_args *a = p;
+    a->rc = conv3d_blocked(a->f, a->D, a->H, a->W, a->g, a->kD, a->kH, a->kW, a->out);
+}
+
+/* A D x H x W image or kD x kH x kW kernel with D > 1: time the blocked
+   engine against the naive one (the reference), or only naive with
+   --engine naive, and write and print the output as a volume. */
+static int run_volume(const float *f_flat, int fD, int fH, int fW, const float *g_flat, int gD, int gH, int gW,
+                      conv_engine engine, int reps, const char *file_o, int print_stdout, const roofline *roof) {
+    if (gD > fD || gH > fH || gW > fW) {
+        fprintf(stderr, "Kernel must not be larger than image (got f %dx%dx%d, g %dx%dx%d)\n", fD, fH, fW, gD, gH, gW);
+        return 1;
+    }
+    size_t n = (size_t)fD * fH * fW, taps = (size_t)gD * gH * gW;
+    double *f = malloc(sizeof(double) * n), *g = malloc(sizeof(double) * taps);
+    double *ref = malloc(sizeof(double) * n), *out = malloc(sizeof(double) * n);
+    float *out_flat = malloc(sizeof(float) * n);
+    if (!f || !g || !ref || !out || !out_flat) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+    for (size_t i = 0; i < n; ++i) f[i] = f_flat[i];
+    for (size_t i = 0; i < taps; ++i) g[i] = g_flat[i];
+
+    bench *bm = bench_create("conv_test");
+    bench_stats naive_stats, stats;
+    vol_args naive = { f, g, ref, fD, fH, fW, gD, gH, gW, 0 };
+    if (time_call(bm, "conv3d_naive", run_conv3d_naive, &naive, reps, &naive_stats) != 0) {
+        fprintf(stderr, "Memory allocation failed\n"); return 1;
+    }
+    stats = naive_stats;
+    const double *result = ref;
+    fprintf(stderr, "Engine: %s (3D)\n", engine == CONV_ENGINE_NAIVE ? "naive" : "blocked");
+    /* double volume in and out */
+    roofline_work work = { 2.0 * n * taps, 2.0 * n * sizeof(double), 2 * n * sizeof(double), omp_get_max_threads(), 1 };
+    roofline_print(stderr, roof, "conv3d_naive", &work, naive_stats.median);
+    if (engine != CONV_ENGINE_NAIVE) {
+        vol_args blocked = { f, g, out, fD, fH, fW, gD, gH, gW, 0 };
+        if (time_call(bm, "conv3d_blocked", run_conv3d_blocked, &blocked, reps, &stats) != 0 || blocked.rc != 0) {
+            fprintf(stderr, "Memory allocation failed\n"); return 1;
+        }
+        result = out;
+
+        double max_diff = 0.0;
+        for (size_t i = 0; i < n; ++i)
+            if (fabs(out[i] - ref[i]) > max_diff) max_diff = fabs(out[i] - ref[i]);
+        double flops = 2.0 * n * taps;
+        fprintf(stderr, "Volume: %d x %d x %d, kernel %d x %d x %d, max |blocked - naive| = %.3g\n",
+                fD, fH, fW, gD, gH, gW, max_diff);
+        fprintf(stderr, "Naive:   %.6f s, %.2f GFLOP/s\n", naive_stats.median, flops / naive_stats.median / 1e9);
+        fprintf(stderr, "Blocked: %.6f s, %.2f GFLOP/s (%.2fx), %zu KB resident per thread\n",
+                stats.median, flops / stats.median / 1e9, naive_stats.median / stats.median,
+                conv3d_blocked_resident(gD, gH, gW) / 1024);
+        roofline_print(stderr, roof, "conv3d_blocked", &work, stats.median);
+    }
+    for (size_t i = 0; i < n; ++i) out_flat[i] = (float)result[i];
+
+    if (file_o) {
+        if (conv_write_volume(file_o, out_flat, fD, fH, fW, CONV_STORAGE_F32) != 0) fprintf(stderr, "Failed to write output\n");
+    }
+    if (print_stdout) {
+        printf("%d %d %d\n", fD, fH, fW);
+        for (int d = 0; d < fD; ++d) {
+            if (d) printf("\n");
+            for (int i = 0; i < fH; ++i) {
+                const float *row = &out_flat[((size_t)d * fH + i) * fW];
+                for (int j = 0; j < fW; ++j) {
+                    if (j) printf(" ");
+                    printf("%.3f", row[j]);
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    fprintf(stderr, "Time: %.6f s\n", stats.median);
+    bench_destroy(bm);
+    free(f); free(g); free(ref); free(out); free(out_flat);
+    return 0;
+}
+
+/* Main program: parse args, read or generate, run conv, print/write output */
+int main(int argc, char **argv) {
+    char *file_f = NULL, *file_g = NULL, *file_o = NULL;
+    int H=0,W=0,kH=0,kW=0;
+    int D=1,kD=1;
+    int print_stdout = 1;
+    int iters = 1;
+    int reps = 1;
+    conv_engine engine = CONV_ENGINE_AUTO;
+    conv_storage_type storage = CONV_STORAGE_F32;
+    int quant_bits = 0;
+    char *serve_path = NULL;
+
+    struct option long_options[] = {
+        {"kH", required_argument, 0, 0},
+        {"kW", required_argument, 0, 0},
+        {"kD", required_argument, 0, 0},
+        {"iters", required_argument, 0, 0},
+        {"reps", required_argument, 0, 0},
+        {"engine", required_argument, 0, 0},
+        {"storage", required_argument, 0, 0},
+        {"quant", required_argument, 0, 0},
+        {"serve", required_argument, 0, 0},
+        {0, 0, 0, 0} // terminator
+    };
+
+    int option_index = 0;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "f:g:o:D:H:W:hp", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 0: // long option
+                if (strcmp(long_options[option_index].name, "kH") == 0) kH = atoi(optarg);
+                if (strcmp(long_options[option_index].name, "kW") == 0) kW = atoi(optarg);
+                if (strcmp(long_options[option_index].name, "kD") == 0) kD = atoi(optarg);
+                if (strcmp(long_options[option_index].name, "iters") == 0) iters = atoi(optarg);
+                if (strcmp(long_options[option_index].name, "reps") == 0) reps = atoi(optarg);
+                if (strcmp(long_options[option_index].name, "engine") == 0) {
+                    int found = 0;
+                    for (int e = 0; e < CONV_NUM_ENGINES; ++e)
+                        if (strcmp(optarg, conv_engine_names[e]) == 0) { engine = (conv_engine)e; found = 1; }
+                    if (!found) { fprintf(stderr, "Unknown engine '%s'\n", optarg); return 1; }
+                }
+                if (strcmp(long_options[option_index].name, "storage") == 0) {
+                    int found = 0;
+                    for (int t = CONV_STORAGE_F32; t <= CONV_STORAGE_BF16; ++t)
+                        if (strcmp(optarg, conv_storage_names[t]) == 0) { storage = (conv_storage_type)t; found = 1; }
+                    if (!found) { fprintf(stderr, "Unknown storage '%s' (float, fp16, bf16)\n", optarg); return 1; }
+                }
+                if (strcmp(long_options[option_index].name, "serve") == 0) serve_path = optarg;
+                if (strcmp(long_options[option_index].name, "quant") == 0) {
+                    if (sscanf(optarg, "int%d", &quant_bits) != 1 || quant_bits < 2 || quant_bits > 16) {
+                        fprintf(stderr, "Unknown quantisation '%s' (int2 ... int16 kernel)\n", optarg); return 1;
+                    }
+                }
+                break;
+            case 'f': file_f = strdup(optarg); break;
+            case 'g': file_g = strdup(optarg); break;
+            case 'o': file_o = strdup(optarg); break;
+            case 'D': D = atoi(optarg); break;
+            case 'H': H = atoi(optarg); break;
+            case 'W': W = atoi(optarg); break;
+            case 'p': print_stdout = 1; break;
+            case 'h':
+            default:
+                fprintf(stderr, "Usage: %s ...\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (serve_path) return serve(serve_path);
+
+    float *f_flat = NULL, *g_flat = NULL;
+    int fD=1,fH=0,fW=0,gD=1,gH=0,gW=0;
+
+    if (D < 1 || kD < 1) { fprintf(stderr, "-D and --kD must be at least 1\n"); return 1; }
+    int generate_random = (H>0 && W>0 && kH>0 && kW>0);
+
+    /* Only read f/g files if we're NOT generating random arrays,
+    or if the file already exists (optional). */
+    if (!generate_random && file_f) {
+        if (conv_read_volume_flat(file_f, &f_flat, &fD, &fH, &fW) != 0) { 
+            fprintf(stderr, "Failed to read f file\n"); 
+            return 1; 
+        }
+    }
+    if (!generate_random && file_g) {
+        if (conv_read_volume_flat(file_g, &g_flat, &gD, &gH, &gW) != 0) { 
+            fprintf(stderr, "Failed to read g file\n"); 
+            return 1; 
+        }
+    }
+
+    if (!f_flat && !(H>0 && W>0)) { fprintf(stderr, "Either provide -f or -H and -W\n"); return 1; }
+    if (!g_flat && !(kH>0 && kW>0)) { fprintf(stderr, "Either provide -g or -kH and -kW\n"); return 1; }
+
+    if (!f_flat) {
+        fD = D; fH = H; fW = W;
+        if (D > 1) printf("D = %d\n", D);
+        printf("H = %d\n", H);
+        printf("W = %d\n", W);
+        f_flat = malloc(sizeof(float)*(size_t)D*H*W);
+        if (!f_flat) { perror("malloc"); return 1; }
+        srand(1234);
+        for (size_t i=0;i<(size_t)D*H*W;++i) f_flat[i] = (float)rand()/RAND_MAX;
+
+        /* save to file if requested */
+        if (file_f) {
+            if (conv_write_volume(file_f, f_flat, fD, fH, fW, storage) != 0) {
+                fprintf(stderr, "Failed to write generated f file\n");
+                return 1;
+            }
+        }
+    }
+
+    if (!g_flat) {
+        gD = kD; gH = kH; gW = kW;
+        g_flat = malloc(sizeof(float)*(size_t)kD*kH*kW);
+        if (!g_flat) { perror("malloc"); return 1; }
+        srand(5678);
+        for (size_t i=0;i<(size_t)kD*kH*kW;++i) g_flat[i] = (float)rand()/RAND_MAX;
+
+        /* save to file if requested */
+        if (file_g) {
+            if (conv_write_volume(file_g, g_flat, gD, gH, gW, CONV_STORAGE_F32) != 0) {
+                fprintf(stderr, "Failed to write generated g file\n");
+                return 1;
+            }
+        }
+    }
+
+    /* final dims */
+    if (f_flat) { /* already set fH,fW */ }
+    if (g_flat) { /* already set gH,gW */ }
+
+    if (iters < 1) { fprintf(stderr, "--iters must be at least 1\n"); return 1; }
+    if (reps < 1) { fprintf(stderr, "--reps must be at least 1\n"); return 1; }
+    if (storage != CONV_STORAGE_F32 && (iters != 1 || engine != CONV_ENGINE_AUTO)) {
+        fprintf(stderr, "--storage %s has its own engine and needs --iters 1\n", conv_storage_names[storage]);
+        return 1;
+    }
+    if (quant_bits && (iters != 1 || engine != CONV_ENGINE_AUTO || storage != CONV_STORAGE_F32)) {
+        fprintf(stderr, "--quant has its own engine and needs --iters 1 and float storage\n");
+        return 1;
+    }
+
+    if (fD > 1 || gD > 1) {
+        if (storage != CONV_STORAGE_F32 || quant_bits || iters != 1 || (engine != CONV_ENGINE_AUTO && engine != CONV_ENGINE_NAIVE)) {
+            fprintf(stderr, "Volumes run the naive or blocked 3D engine only, without --storage, --quant or --iters\n");
+            return 1;
+        }
+        roofline *roof = roofline_open(NULL);
+        int rc = run_volume(f_flat, fD, fH, fW, g_flat, gD, gH, gW, engine, reps, file_o, print_stdout, roof);
+        roofline_close(roof);
+        free(f_flat); free(g_flat);
+        free(file_f); free(file_g); free(file_o);
+        return rc;
+    }
+
+
+    size_t n = (size_t)fH * fW;
+    float *out_flat = malloc(sizeof(float) * n);
+    if (!out_flat) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+
+    /* the 16-bit, 8-bit and iterated runs check themselves against the double engine */
+    double **f_dp = NULL, **g_dp = NULL, **out_dp = NULL;
+    if (storage != CONV_STORAGE_F32 || quant_bits || iters > 1) {
+        f_dp = conv_alloc_doubleptr_from_float_flat(f_flat, fH, fW);
+        g_dp = conv_alloc_doubleptr_from_float_flat(g_flat, gH, gW);
+        out_dp = conv_alloc_doubleptr_from_float_flat(f_flat, fH, fW);
+        if (!f_dp || !g_dp || !out_dp) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+    }
+
+    /* perform convolution (timed, see time_call) */
+    bench *bm = bench_create("conv_test");
+    bench_stats stats;
+    double elapsed;
+    roofline *roof = roofline_open(NULL);
+    if (storage != CONV_STORAGE_F32) {
+        uint16_t *f_half = malloc(sizeof(uint16_t) * n);
+        uint16_t *out_half = malloc(sizeof(uint16_t) * n);
+        if (!f_half || !out_half) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+        conv_half_from_float(storage, f_flat, f_half, n);
+
+        fprintf(stderr, "Engine: %s (%s conversion)\n", conv_storage_names[storage], conv_half_isa(storage));
+        half_args half = { storage, f_half, g_flat, out_half, fH, fW, gH, gW, 0 };
+        char name[32];
+        snprintf(name, sizeof(name), "conv2d_%s", conv_storage_names[storage]);
+        if (time_call(bm, name, run_conv2d_half, &half, reps, &stats) != 0 || half.rc != 0) {
+            fprintf(stderr, "Memory allocation failed\n"); return 1;
+        }
+        elapsed = stats.median;
+
+        /* accuracy against the double engine on the unrounded float input */
+        conv2d_naive(f_dp, fH, fW, g_dp, gH, gW, out_dp);
+        double max_err = 0.0, sum_sq = 0.0, max_ref = 0.0;
+        long off_3dp = 0;
+        conv_half_to_float(storage, out_half, out_flat, n);
+        for (int i = 0; i < fH; ++i) {
+            const float *row = &out_flat[(size_t)i * fW];
+            for (int j = 0; j < fW; ++j) {
+                double ref = out_dp[i][j], err = fabs(row[j] - ref);
+                if (err > max_err) max_err = err;
+                if (fabs(ref) > max_ref) max_ref = fabs(ref);
+                sum_sq += err * err;
+                if (err > 0.0005) off_3dp++;
+            }
+        }
+        /* f read once and out written once, vs 8-byte doubles for the other engines */
+        double bytes = 2.0 * n * sizeof(uint16_t);
+        fprintf(stderr, "Storage: %zu bytes per pixel, %.2f GB/s\n", conv_storage_size(storage), bytes / elapsed / 1e9);
+        fprintf(stderr, "Accuracy vs double: max |err| %.3g (%.3g of max |out|), rms %.3g, %.2f%% of pixels off by more than 0.0005\n",
+                max_err, max_ref > 0 ? max_err / max_ref : 0.0, sqrt(sum_sq / n), 100.0 * off_3dp / n);
+        roofline_work work = { 2.0 * n * gH * gW, bytes, bytes, omp_get_max_threads(), 0 };
+        roofline_print(stderr, roof, conv_storage_names[storage], &work, elapsed);
+        free(f_half);
+        free(out_half);
+    } else if (quant_bits) {
+        conv_quant_kernel k;
+        if (conv_quant_kernel_init(&k, g_flat, gH, gW, quant_bits) != 0) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+
+        /* an image that is already whole numbers 0..255 is taken as 8-bit
+           camera data and coded exactly; anything else maps its range */
+        float f_lo = f_flat[0], f_hi = f_flat[0];
+        int is_u8 = 1;
+        for (size_t i = 0; i < n; ++i) {
+            if (f_flat[i] < f_lo) f_lo = f_flat[i];
+            if (f_flat[i] > f_hi) f_hi = f_flat[i];
+            if (nearbyintf(f_flat[i]) != f_flat[i]) is_u8 = 0; /* also catches NaN and values out of int range */
+        }
+        is_u8 = is_u8 && f_lo >= 0.0f && f_hi <= 255.0f;
+        conv_quant_params fq = is_u8 ? (conv_quant_params){ 1.0f, 0 } : conv_quant_params_for_range(f_lo, f_hi);
+
+        /* output range bound from the input range and the quantised taps */
+        float in_lo = fq.scale * (0 - fq.zero_point), in_hi = fq.scale * (255 - fq.zero_point);
+        double o_lo = 0.0, o_hi = 0.0;
+        for (int t = 0; t < gH * gW; ++t) {
+            double w = (double)k.scale * k.q[t];
+            o_lo += w > 0 ? w * in_lo : w * in_hi;
+            o_hi += w > 0 ? w * in_hi : w * in_lo;
+        }
+        conv_quant_params oq = conv_quant_params_for_range((float)o_lo, (float)o_hi);
+
+        uint8_t *f_u8 = malloc(n), *out_u8 = malloc(n);
+        float *fd = malloc(sizeof(float) * n), *gd = malloc(sizeof(float) * gH * gW);
+        double **fd_dp = NULL, **gd_dp = NULL;
+        if (!f_u8 || !out_u8 || !fd || !gd) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+        conv_quantize_u8(f_flat, n, fq, f_u8);
+
+        fprintf(stderr, "Engine: u8 x int%d (%s)\n", quant_bits, k.isa);
+        fprintf(stderr, "Input scale %.6g zero point %d, kernel scale %.6g, output scale %.6g zero point %d\n",
+                fq.scale, fq.zero_point, k.scale, oq.scale, oq.zero_point);
+        u8_args u8 = { f_u8, out_u8, fH, fW, fq, oq, &k, 0 };
+        char name[32];
+        snprintf(name, sizeof(name), "conv2d_u8_int%d", quant_bits);
+        if (time_call(bm, name, run_conv2d_u8, &u8, reps, &stats) != 0 || u8.rc != 0) {
+            fprintf(stderr, "Memory allocation failed\n"); return 1;
+        }
+        elapsed = stats.median;
+
+        /* Validation 1: the double engine on the same dequantised inputs,
+           requantised, must give the same codes up to rounding of the scale
+           product. Validation 2: end-to-end error against the float input. */
+        conv_dequantize_u8(f_u8, n, fq, fd);
+        for (int t = 0; t < gH * gW; ++t) gd[t] = k.scale * k.q[t];
+        fd_dp = conv_alloc_doubleptr_from_float_flat(fd, fH, fW);
+        gd_dp = conv_alloc_doubleptr_from_float_flat(gd, gH, gW);
+        if (!fd_dp || !gd_dp) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+        conv2d_naive(fd_dp, fH, fW, gd_dp, gH, gW, out_dp);
+        long code_diff = 0, code_off = 0;
+        for (int i = 0; i < fH; ++i)
+            for (int j = 0; j < fW; ++j) {
+                double v = oq.zero_point + out_dp[i][j] / oq.scale;
+                long expect = v < 0 ? 0 : v > 255 ? 255 : (long)floor(v + 0.5);
+                long d = labs(expect - out_u8[(size_t)i * fW + j]);
+                if (d > code_diff) code_diff = d;
+                if (d) code_off++;
+            }
+        conv2d_naive(f_dp, fH, fW, g_dp, gH, gW, out_dp);
+        double max_err = 0.0, sum_sq = 0.0;
+        for (int i = 0; i < fH; ++i)
+            for (int j = 0; j < fW; ++j) {
+                double v = oq.scale * (out_u8[(size_t)i * fW + j] - oq.zero_point);
+                double err = fabs(v - out_dp[i][j]);
+                if (err > max_err) max_err = err;
+                sum_sq += err * err;
+                out_flat[(size_t)i * fW + j] = (float)v;
+            }
+        fprintf(stderr, "Codes vs float path on the same quantised inputs: %ld of %zu differ, by at most %ld\n",
+                code_off, n, code_diff);
+        fprintf(stderr, "Accuracy vs double: max |err| %.3g (%.2f output steps), rms %.3g\n",
+                max_err, max_err / oq.scale, sqrt(sum_sq / n));
+        fprintf(stderr, "Storage: 1 byte per pixel, %.2f GB/s\n", 2.0 * n / elapsed / 1e9);
+
+        conv_free_doubleptr_double(fd_dp, fH);
+        conv_free_doubleptr_double(gd_dp, gH);
+        free(f_u8); free(out_u8); free(fd); free(gd);
+        conv_quant_kernel_free(&k);
+    } else {
+        conv_options plan_opts = conv_default_options();
+        plan_opts.engine = engine;
+        plan_opts.iters = iters;
+        conv_plan *plan = conv_plan_create(fH, fW, g_flat, gH, gW, &plan_opts);
+        if (!plan) {
+            if (errno == EINVAL && iters > 1) fprintf(stderr, "--iters needs the auto or temporal engine\n");
+            else if (errno == EINVAL) fprintf(stderr, "The sat engine needs a constant kernel\n");
+            else fprintf(stderr, "Memory allocation failed\n");
+            return 1;
+        }
+        plan_args run = { plan, f_flat, out_flat };
+        char name[32];
+        snprintf(name, sizeof(name), "conv2d_%s", conv_engine_names[conv_plan_engine(plan)]);
+
+        if (iters == 1) {
+            fprintf(stderr, "Engine: %s\n", conv_engine_names[conv_plan_engine(plan)]);
+            if (conv_plan_engine(plan) == CONV_ENGINE_SPARSE) fprintf(stderr, "Taps: %d of %d\n", conv_plan_taps(plan), gH * gW);
+            if (time_call(bm, name, run_conv_execute, &run, reps, &stats) != 0) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+            elapsed = stats.median;
+        } else {
+            /* naive T passes first as the reference, then the tiled plan */
+            double **scratch = conv_alloc_doubleptr_from_float_flat(f_flat, fH, fW);
+            if (!scratch) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+            iter_args naive = { f_dp, g_dp, out_dp, fH, fW, gH, gW, iters, scratch };
+            bench_stats naive_stats;
+            if (time_call(bm, "conv2d_naive_iters", run_conv2d_naive_iters, &naive, reps, &naive_stats) != 0 ||
+                time_call(bm, name, run_conv_execute, &run, reps, &stats) != 0) {
+                fprintf(stderr, "Memory allocation failed\n"); return 1;
+            }
+            elapsed = stats.median;
+
+            /* the tiled sums are bit-identical, so only the float rounding may differ */
+            double max_diff = 0.0;
+            for (int i = 0; i < fH; ++i)
+                for (int j = 0; j < fW; ++j) {
+                    double d = out_flat[(size_t)i * fW + j] - (float)out_dp[i][j];
+                    if (d < 0) d = -d;
+                    if (d > max_diff) max_diff = d;
+                }
+
+            /* both read and write a full double image per naive pass */
+            double naive_bytes = 2.0 * iters * (double)fH * fW * sizeof(double);
+            double tiled_bytes = (double)conv2d_temporal_traffic(fH, fW, gH, gW, iters);
+            fprintf(stderr, "Iterations: %d, max |temporal - naive| = %.3g\n", iters, max_diff);
+            fprintf(stderr, "Naive passes: %.6f s, %.2f GB moved, %.2f GB/s\n",
+                    naive_stats.median, naive_bytes / 1e9, naive_bytes / naive_stats.median / 1e9);
+            fprintf(stderr, "Temporal:     %.6f s, %.2f GB moved, %.2f GB/s effective (%.1f%% of the naive traffic saved)\n",
+                    stats.median, tiled_bytes / 1e9, naive_bytes / stats.median / 1e9,
+                    100.0 * (1.0 - tiled_bytes / naive_bytes));
+            conv_free_doubleptr_double(scratch, fH);
+        }
+
+        /* compulsory traffic is the float image in and out; the plan's double
+           copies of both add to the working set */
+        roofline_work work = { plan_flops(plan, n, gH, gW, iters), 2.0 * n * sizeof(float),
+                               n * (2 * sizeof(float) + 2 * sizeof(double)), omp_get_max_threads(), 1 };
+        roofline_print(stderr, roof, conv_engine_names[conv_plan_engine(plan)], &work, elapsed);
+        conv_plan_destroy(plan);
+    }
+
+    if (file_o) {
+        if (conv_write_array(file_o, out_flat, fH, fW, storage) != 0) fprintf(stderr, "Failed to write output\n");
+    }
+
+    if (print_stdout) {
+        printf("%d %d\n", fH, fW);
+        for (int i = 0; i < fH; ++i) {
+            for (int j = 0; j < fW; ++j) {
+                if (j) printf(" ");
+                printf("%.3f", out_flat[i*(size_t)fW + j]);
+            }
+            printf("\n");
+        }
+    }
+
+    fprintf(stderr, "Time: %.6f s\n", elapsed);
+    bench_destroy(bm);
+    roofline_close(roof);
+
+    /* cleanup */
+    free(f_flat); free(g_flat); free(out_flat);
+    conv_free_doubleptr_double(f_dp, fH); conv_free_doubleptr_double(g_dp, gH); conv_free_doubleptr_double(out_dp, fH);
+    if (file_f) free(file_f); if (file_g) free(file_g); if (file_o) free(file_o);
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include "half.h"
+
+#include <string.h>
+#include <immintrin.h>
+
+const char *const conv_storage_names[] = { "float", "fp16", "bf16" };
+
+size_t conv_storage_size(conv_storage_type type) {
+    return type == CONV_STORAGE_F32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+/* ---- portable conversions, also used for the tails of the SIMD loops ---- */
+
+static uint16_t f16_from_float(float x) {
+    uint32_t b;
+    memcpy(&b, &x, sizeof(b));
+    uint16_t sign = (b >> 16) & 0x8000;
+    uint32_t a = b & 0x7fffffff;
+    if (a >= 0x7f800000) return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0); /* inf, quiet NaN */
+    if (a >= 0x477ff000) return sign | 0x7c00; /* 65520 and up round to inf */
+    if (a < 0x38800000) {
+        /* below 2^-14: half subnormal in units of 2^-24 */
+        uint32_t e = a >> 23;
+        if (e < 102) return sign;
+        uint32_t m = (a & 0x7fffff) | 0x800000;
+        int shift = 126 - e;
+        uint32_t r = m >> shift, rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (r & 1))) r++;
+        return sign | r;
+    }
+    uint32_t h = (a - 0x38000000) >> 13, rem = a & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return sign | h;
+}
+
+static float f16_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t e = (h >> 10) & 0x1f, m = h & 0x3ff, b;
+    if (e == 0x1f) b = sign | 0x7f800000 | (m << 13) | (m ? 0x400000 : 0); /* NaNs come out quiet */
+    else if (e) b = sign | ((e + 112) << 23) | (m << 13);
+    else {
+        float x = m * 0x1p-24f; /* zero or subnormal */
+        return sign ? -x : x;
+    }
+    float x;
+    memcpy(&x, &b, sizeof(x));
+    return x;
+}
+
+static uint16_t bf16_from_float(float x) {
+    uint32_t b;
+    memcpy(&b, &x, sizeof(b));
+    if ((b & 0x7fffffff) > 0x7f800000) return (b >> 16) | 0x40; /* keep NaNs quiet */
+    return (b + 0x7fff + ((b >> 16) & 1)) >> 16;
+}
+
+static float bf16_to_float(uint16_t h) {
+    uint32_t b = (uint32_t)h << 16;
+    float x;
+    memcpy(&x, &b, sizeof(x));
+    return x;
+}
+
+static void f16_widen_scalar(const uint16_t *src, float *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = f16_to_float(src[i]);
+}
+
+static void f16_narrow_scalar(const float *src, uint16_t *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = f16_from_float(src[i]);
+}
+
+static void bf16_widen_scalar(const uint16_t *src, float *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = bf16_to_float(src[i]);
+}
+
+static void bf16_narrow_scalar(const float *src, uint16_t *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] = bf16_from_float(src[i]);
+}
+
+/* ---- F16C / AVX2 ---- */
+
+__attribute__((target("avx,f16c")))
+static void f16_widen_f16c(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+    f16_widen_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx,f16c")))
+static void f16_narrow_f16c(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    f16_narrow_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void bf16_widen_avx2(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_slli_epi32(w, 16));
+    }
+    bf16_widen_scalar(src + i, dst + i, n - i);
+}
+
+/* the same rounding as bf16_from_float, on 8 lanes */
+__attribute__((target("avx2")))
+static __m256i bf16_round_avx2(__m256 x) {
+    __m256i b = _mm256_castps_si256(x);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(b, 16), _mm256_set1_epi32(1));
+    __m256i r = _mm256_srli_epi32(_mm256_add_epi32(b, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff))), 16);
+    __m256i quiet = _mm256_or_si256(_mm256_srli_epi32(b, 16), _mm256_set1_epi32(0x40));
+    __m256 nan = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+    return _mm256_blendv_epi8(r, quiet, _mm256_castps_si256(nan));
+}
+
+__attribute__((target("avx2")))
+static void bf16_narrow_avx2(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = bf16_round_avx2(_mm256_loadu_ps(src + i));
+        __m256i hi = bf16_round_avx2(_mm256_loadu_ps(src + i + 8));
+        /* packus works per 128-bit lane; restore element order afterwards */
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+    bf16_narrow_scalar(src + i, dst + i, n - i);
+}
+
+/* ---- AVX-512 ---- */
+
+__attribute__((target("avx512f")))
+static void f16_widen_avx512(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(src + i))));
+    f16_widen_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void f16_narrow_avx512(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    f16_narrow_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void bf16_widen_avx512(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *)(src + i)));
+        _mm512_storeu_si512(dst + i, _mm512_slli_epi32(w, 16));
+    }
+    bf16_widen_scalar(src + i, dst + i, n - i);
+}
+
+/* vcvtneps2bf16 rounds to nearest even like bf16_from_float, but flushes
+   float subnormals (below 1.2e-38) to zero */
+__attribute__((target("avx512f,avx512bf16")))
+static void bf16_narrow_avx512(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh r = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), (__m256i)r);
+    }
+    bf16_narrow_scalar(src + i, dst + i, n - i);
+}
+
+/* ---- dispatch ---- */
+
+typedef struct {
+    void (*widen)(const uint16_t *, float *, size_t);
+    void (*narrow)(const float *, uint16_t *, size_t);
+    const char *isa;
+} half_impl;
+
+static half_impl impl_f16, impl_bf16;
+static int selected;
+
+/* Idempotent, so a race between first callers is harmless */
+static void half_select(void) {
+    if (__atomic_load_n(&selected, __ATOMIC_ACQUIRE)) return;
+    __builtin_cpu_init();
+    half_impl f16 = { f16_widen_scalar, f16_narrow_scalar, "scalar" };
+    half_impl bf16 = { bf16_widen_scalar, bf16_narrow_scalar, "scalar" };
+    if (__builtin_cpu_supports("avx512f")) {
+        f16 = (half_impl){ f16_widen_avx512, f16_narrow_avx512, "AVX-512" };
+        if (__builtin_cpu_supports("avx512bf16"))
+            bf16 = (half_impl){ bf16_widen_avx512, bf16_narrow_avx512, "AVX-512 BF16" };
+        else
+            bf16 = (half_impl){ bf16_widen_avx512, bf16_narrow_avx2, "AVX-512/AVX2" };
+    } else {
+        if (__builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx"))
+            f16 = (half_impl){ f16_widen_f16c, f16_narrow_f16c, "F16C" };
+        if (__builtin_cpu_supports("avx2"))
+            bf16 = (half_impl){ bf16_widen_avx2, bf16_narrow_avx2, "AVX2" };
+    }
+    impl_f16 = f16;
+    impl_bf16 = bf16;
+    __atomic_store_n(&selected, 1, __ATOMIC_RELEASE);
+}
+
+const char *conv_half_isa(conv_storage_type type) {
+    half_select();
+    if (type == CONV_STORAGE_F16) return impl_f16.isa;
+    if (type == CONV_STORAGE_BF16) return impl_bf16.isa;
+    return "none";
+}
+
+void conv_half_from_float(conv_storage_type type, const float *src, uint16_t *dst, size_t n) {
+    half_select();
+    (type == CONV_STORAGE_BF16 ? impl_bf16 : impl_f16).narrow(src, dst, n);
+}
+
+void conv_half_to_float(conv_storage_type type, const uint16_t *src, float *dst, size_t n) {
+    half_select();
+    (type == CONV_STORAGE_BF16 ? impl_bf16 : impl_f16).widen(src, dst, n);
+}
@@ -0,0 +1,36 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 16-bit storage formats for images. Values are widened to float for
+   arithmetic and narrowed back with round-to-nearest-even.
+
+   fp16 (IEEE binary16): 10-bit mantissa, about 3 significant decimals,
+   largest finite value 65504.
+   bf16 (bfloat16): the top half of a float; float's range with an 8-bit
+   mantissa, about 2 significant decimals.
+
+   The row converters pick the widest implementation the CPU supports at
+   run time (AVX-512, F16C/AVX2, else portable C). */
+
+typedef enum {
+    CONV_STORAGE_F32,
+    CONV_STORAGE_F16,
+    CONV_STORAGE_BF16
+} conv_storage_type;
+
+extern const char *const conv_storage_names[]; /* "float", "fp16", "bf16" */
+
+/* Bytes per element of a storage type */
+size_t conv_storage_size(conv_storage_type type);
+
+/* Name of the conversion code selected for type, e.g. "F16C" or "scalar" */
+const char *conv_half_isa(conv_storage_type type);
+
+/* Convert n values between float and type (CONV_STORAGE_F16 or CONV_STORAGE_BF16) */
+void conv_half_from_float(conv_storage_type type, const float *src, uint16_t *dst, size_t n);
+void conv_half_to_float(conv_storage_type type, const uint16_t *src, float *dst, size_t n);
+
+#endif
@@ -0,0 +1,249 @@
+#include "mconv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+const char *const conv_layout_names[] = { "nchw", "nhwc", "nchwc" };
+
+static int blocks(int n) {
+    return (n + CONV_MC_BLOCK - 1) / CONV_MC_BLOCK;
+}
+
+static size_t offset(conv_layout layout, int C, int H, int W, int n, int c, int i, int j) {
+    if (layout == CONV_LAYOUT_NHWC) return (((size_t)n * H + i) * W + j) * C + c;
+    if (layout == CONV_LAYOUT_NCHWC)
+        return ((((size_t)n * blocks(C) + c / CONV_MC_BLOCK) * H + i) * W + j) * CONV_MC_BLOCK + c % CONV_MC_BLOCK;
+    return (((size_t)n * C + c) * H + i) * W + j;
+}
+
+size_t conv_mc_image_size(conv_layout layout, int N, int C, int H, int W) {
+    int channels = layout == CONV_LAYOUT_NCHWC ? blocks(C) * CONV_MC_BLOCK : C;
+    return (size_t)N * channels * H * W;
+}
+
+void conv_mc_convert(conv_layout from, const float *src, conv_layout to, float *dst, int N, int C, int H, int W) {
+    if (to == CONV_LAYOUT_NCHWC) memset(dst, 0, sizeof(float) * conv_mc_image_size(to, N, C, H, W));
+    #pragma omp parallel for collapse(3)
+    for (int n = 0; n < N; ++n)
+        for (int c = 0; c < C; ++c)
+            for (int i = 0; i < H; ++i)
+                for (int j = 0; j < W; ++j)
+                    dst[offset(to, C, H, W, n, c, i, j)] = src[offset(from, C, H, W, n, c, i, j)];
+}
+
+/* ---- engines ----
+
+   Each is written once as an always-inline body and compiled per ISA by
+   MC_ISA below, so the same loops get AVX-512, AVX2 or SSE2 registers. */
+#define MC_INLINE static inline __attribute__((always_inline))
+#define MC_MAX_PIX 8
+
+/* o[p][0..CONV_MC_BLOCK) += sum over kj < kW, c < C of x[(p + kj) * xs + c] * w[(kj * C + c) * ws + 0..CONV_MC_BLOCK)
+   for P pixels p at stride os; P is a constant after inlining, so acc stays in registers */
+MC_INLINE void mc_tile(int P, const float *x, int xs, int C, int kW, const float *w, int ws, float *o, int os) {
+    float acc[MC_MAX_PIX][CONV_MC_BLOCK];
+    for (int p = 0; p < P; ++p)
+        for (int kk = 0; kk < CONV_MC_BLOCK; ++kk) acc[p][kk] = o[(size_t)p * os + kk];
+    for (int kj = 0; kj < kW; ++kj)
+        for (int c = 0; c < C; ++c) {
+            const float *wr = &w[((size_t)kj * C + c) * ws];
+            for (int p = 0; p < P; ++p) {
+                float xv = x[(size_t)(p + kj) * xs + c];
+                #pragma omp simd
+                for (int kk = 0; kk < CONV_MC_BLOCK; ++kk) acc[p][kk] += xv * wr[kk];
+            }
+        }
+    for (int p = 0; p < P; ++p)
+        for (int kk = 0; kk < CONV_MC_BLOCK; ++kk) o[(size_t)p * os + kk] = acc[p][kk];
+}
+
+/* One kernel row applied along an image row of W pixels: x is the input
+   row (pixel stride xs), o the output row (pixel stride os). Pixels whose
+   taps all lie inside the row go PIX at a time; the border pixels skip the
+   taps that fall outside, as conv2d_naive does. */
+MC_INLINE void mc_row_taps(int PIX, const float *x, int xs, int C, int kW, int W, const float *w, int ws,
+                           float *o, int os) {
+    int cc = (kW - 1) / 2;
+    int ja = cc, jb = W - (kW - 1 - cc);
+    if (jb < ja) jb = ja;
+    int j = ja;
+    for (; j + PIX <= jb; j += PIX) mc_tile(PIX, &x[(size_t)(j - cc) * xs], xs, C, kW, w, ws, &o[(size_t)j * os], os);
+    for (; j < jb; ++j) mc_tile(1, &x[(size_t)(j - cc) * xs], xs, C, kW, w, ws, &o[(size_t)j * os], os);
+    for (int e = 0; e < W; ++e) {
+        if (e == ja) e = jb;
+        if (e >= W) break;
+        for (int kj = 0; kj < kW; ++kj) {
+            int sj = e + kj - cc;
+            if (sj < 0 || sj >= W) continue;
+            mc_tile(1, &x[(size_t)sj * xs], xs, C, 1, &w[(size_t)kj * C * ws], ws, &o[(size_t)e * os], os);
+        }
+    }
+}
+
+/* nchw: output row i of plane (n, group = k), one tap at a time along the row */
+MC_INLINE void nchw_row(const conv_mc_kernel *k, const float *f, int H, int W, int n, int o, int i, float *out) {
+    int C = k->C, kH = k->kH, kW = k->kW;
+    int cr = (kH - 1) / 2, cc = (kW - 1) / 2;
+    float *dst = &out[(((size_t)n * k->K + o) * H + i) * W];
+    memset(dst, 0, sizeof(float) * W);
+    for (int c = 0; c < C; ++c) {
+        const float *plane = &f[((size_t)n * C + c) * H * W];
+        const float *g = &k->packed[((size_t)o * C + c) * kH * kW];
+        for (int ki = 0; ki < kH; ++ki) {
+            int si = i + ki - cr;
+            if (si < 0 || si >= H) continue;
+            for (int kj = 0; kj < kW; ++kj) {
+                int dx = kj - cc;
+                int j0 = dx < 0 ? -dx : 0, j1 = dx > 0 ? W - dx : W;
+                const float *src = &plane[(size_t)si * W];
+                float w = g[ki * kW + kj];
+                #pragma omp simd
+                for (int j = j0; j < j1; ++j) dst[j] += w * src[j + dx];
+            }
+        }
+    }
+}
+
+/* nhwc: output row i of image n, all K channels. Sums go to scratch with
+   the channels padded to Kp (weights [ki][kj][c][Kp]), then out. */
+MC_INLINE void nhwc_row(int PIX, const conv_mc_kernel *k, const float *f, int H, int W, int n, int i, float *out,
+                        float *acc) {
+    int C = k->C, K = k->K, Kp = k->Kp, kH = k->kH, kW = k->kW;
+    int cr = (kH - 1) / 2;
+    memset(acc, 0, sizeof(float) * W * Kp);
+    for (int ki = 0; ki < kH; ++ki) {
+        int si = i + ki - cr;
+        if (si < 0 || si >= H) continue;
+        const float *x = &f[((size_t)n * H + si) * W * C];
+        const float *w = &k->packed[(size_t)ki * kW * C * Kp];
+        for (int k0 = 0; k0 < Kp; k0 += CONV_MC_BLOCK)
+            mc_row_taps(PIX, x, C, C, kW, W, &w[k0], Kp, &acc[k0], Kp);
+    }
+    float *dst = &out[((size_t)n * H + i) * W * K];
+    for (int j = 0; j < W; ++j) memcpy(&dst[(size_t)j * K], &acc[(size_t)j * Kp], sizeof(float) * K);
+}
+
+/* nchwc: output row i of channel block (n, group = kb); weights
+   [kb][cb][ki][kj][c][CONV_MC_BLOCK] */
+MC_INLINE void nchwc_row(int PIX, const conv_mc_kernel *k, const float *f, int H, int W, int n, int kb, int i,
+                         float *out) {
+    int Cb = k->Cp / CONV_MC_BLOCK, Kb = k->Kp / CONV_MC_BLOCK, kH = k->kH, kW = k->kW;
+    int cr = (kH - 1) / 2;
+    size_t plane = (size_t)H * W * CONV_MC_BLOCK;
+    float *dst = &out[((size_t)n * Kb + kb) * plane + (size_t)i * W * CONV_MC_BLOCK];
+    memset(dst, 0, sizeof(float) * W * CONV_MC_BLOCK);
+    for (int cb = 0; cb < Cb; ++cb) {
+        const float *src = &f[((size_t)n * Cb + cb) * plane];
+        for (int ki = 0; ki < kH; ++ki) {
+            int si = i + ki - cr;
+            if (si < 0 || si >= H) continue;
+            const float *w = &k->packed[(((size_t)kb * Cb + cb) * kH + ki) * kW * CONV_MC_BLOCK * CONV_MC_BLOCK];
+            mc_row_taps(PIX, &src[(size_t)si * W * CONV_MC_BLOCK], CONV_MC_BLOCK, CONV_MC_BLOCK, kW, W, w, CONV_MC_BLOCK, dst, CONV_MC_BLOCK);
+        }
+    }
+}
+
+#define MC_ROW_ARGS const conv_mc_kernel *k, const float *f, int H, int W, int n, int group, int i, float *out, float *scratch
+
+#define MC_ISA(name, flags, pix)                                                                \
+    __attribute__((target(flags))) static void nchw_##name(MC_ROW_ARGS) {                       \
+        (void)scratch;                                                                          \
+        nchw_row(k, f, H, W, n, group, i, out);                                                 \
+    }                                                                                           \
+    __attribute__((target(flags))) static void nhwc_##name(MC_ROW_ARGS) {                       \
+        (void)group;                                                                            \
+        nhwc_row(pix, k, f, H, W, n, i, out, scratch);                                          \
+    }                                                                                           \
+    __attribute__((target(flags))) static void nchwc_##name(MC_ROW_ARGS) {                      \
+        (void)scratch;                                                                          \
+        nchwc_row(pix, k, f, H, W, n, group, i, out);                                           \
+    }
+
+/* AVX-512 has 32 vector registers, room for 8 pixels of CONV_MC_BLOCK floats */
+MC_ISA(avx512, "avx512f", 8)
+MC_ISA(avx2, "avx2,fma", 4)
+MC_ISA(sse2, "sse2", 4)
+
+/* ---- kernel setup ---- */
+
+static int isa_allowed(const char *name) {
+    const char *want = getenv("CONV_MC_ISA");
+    if (!want || !*want) return 1;
+    return strcmp(want, name) == 0;
+}
+
+int conv_mc_kernel_init(conv_mc_kernel *k, conv_layout layout, const float *g, int K, int C, int kH, int kW) {
+    memset(k, 0, sizeof(*k));
+    if (K <= 0 || C <= 0 || kH <= 0 || kW <= 0 || layout > CONV_LAYOUT_NCHWC) return -1;
+    k->K = K;
+    k->C = C;
+    k->kH = kH;
+    k->kW = kW;
+    k->layout = layout;
+    k->Kp = layout == CONV_LAYOUT_NCHW ? K : blocks(K) * CONV_MC_BLOCK;
+    k->Cp = layout == CONV_LAYOUT_NCHWC ? blocks(C) * CONV_MC_BLOCK : C;
+    size_t taps = (size_t)k->Kp * k->Cp * kH * kW;
+    k->packed = calloc(taps, sizeof(float));
+    if (!k->packed) return -1;
+
+    for (int o = 0; o < K; ++o)
+        for (int c = 0; c < C; ++c)
+            for (int ki = 0; ki < kH; ++ki)
+                for (int kj = 0; kj < kW; ++kj) {
+                    float w = g[(((size_t)o * C + c) * kH + ki) * kW + kj];
+                    size_t at;
+                    if (layout == CONV_LAYOUT_NHWC)
+                        at = (((size_t)ki * kW + kj) * C + c) * k->Kp + o;
+                    else if (layout == CONV_LAYOUT_NCHWC)
+                        at = ((((((size_t)(o / CONV_MC_BLOCK) * (k->Cp / CONV_MC_BLOCK) + c / CONV_MC_BLOCK) * kH + ki) * kW + kj)
+                               * CONV_MC_BLOCK + c % CONV_MC_BLOCK) * CONV_MC_BLOCK) + o % CONV_MC_BLOCK;
+                    else
+                        at = (((size_t)o * C + c) * kH + ki) * kW + kj;
+                    k->packed[at] = w;
+                }
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && isa_allowed("avx512")) {
+        k->isa = "AVX-512";
+        k->row = layout == CONV_LAYOUT_NHWC ? nhwc_avx512 : layout == CONV_LAYOUT_NCHWC ? nchwc_avx512 : nchw_avx512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && isa_allowed("avx2")) {
+        k->isa = "AVX2";
+        k->row = layout == CONV_LAYOUT_NHWC ? nhwc_avx2 : layout == CONV_LAYOUT_NCHWC ? nchwc_avx2 : nchw_avx2;
+    } else {
+        k->isa = "SSE2";
+        k->row = layout == CONV_LAYOUT_NHWC ? nhwc_sse2 : layout == CONV_LAYOUT_NCHWC ? nchwc_sse2 : nchw_sse2;
+    }
+    return 0;
+}
+
+void conv_mc_kernel_free(conv_mc_kernel *k) {
+    free(k->packed);
+    k->packed = NULL;
+}
+
+int conv2d_mc(const conv_mc_kernel *k, const float *f, int N, int H, int W, float *out) {
+    /* work items are image rows of one plane (nchw), one channel block
+       (nchwc) or all channels (nhwc) */
+    int groups = k->layout == CONV_LAYOUT_NCHW ? k->K : k->layout == CONV_LAYOUT_NCHWC ? k->Kp / CONV_MC_BLOCK : 1;
+    size_t acc_len = k->layout == CONV_LAYOUT_NHWC ? (size_t)W * k->Kp : 0;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float *acc = acc_len ? malloc(sizeof(float) * acc_len) : NULL;
+        if (acc_len && !acc) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for collapse(3)
+        for (int n = 0; n < N; ++n)
+            for (int g = 0; g < groups; ++g)
+                for (int i = 0; i < H; ++i) {
+                    if (acc_len && !acc) continue;
+                    k->row(k, f, H, W, n, g, i, out, acc);
+                }
+        free(acc);
+    }
+    return failed ? -1 : 0;
+}
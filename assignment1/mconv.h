@@ -0,0 +1,58 @@
+#ifndef MCONV_H
+#define MCONV_H
+
+#include <stddef.h>
+
+/* Multi-channel conv2d: N images of C channels, K output channels,
+     out[n][k][i][j] = sum over c, ki, kj of f[n][c][i + ki - centre_r][j + kj - centre_c] * g[k][c][ki][kj]
+   with the zero padding and centre rule of conv2d_naive, in float.
+
+   Images are stored in one of three layouts:
+     nchw   planes: [N][C][H][W]
+     nhwc   channels last: [N][H][W][C]
+     nchwc  channel blocks of CONV_MC_BLOCK: [N][ceil(C/CONV_MC_BLOCK)][H][W][CONV_MC_BLOCK],
+            channels past C are zero
+   The output uses the layout of the input. nchw is vectorised along image
+   rows, nhwc and nchwc along output channels, CONV_MC_BLOCK at a time, for a
+   few pixels at once so every weight vector loaded is used several times.
+
+   conv_mc_kernel_init picks the widest code the CPU supports; for testing,
+   CONV_MC_ISA=avx512|avx2|sse2 restricts the choice. */
+#define CONV_MC_BLOCK 16
+
+typedef enum {
+    CONV_LAYOUT_NCHW,
+    CONV_LAYOUT_NHWC,
+    CONV_LAYOUT_NCHWC
+} conv_layout;
+
+extern const char *const conv_layout_names[]; /* "nchw", "nhwc", "nchwc" */
+
+/* Floats needed for an image in a layout, padding included */
+size_t conv_mc_image_size(conv_layout layout, int N, int C, int H, int W);
+
+/* Copy an image between layouts (src and dst must not overlap) */
+void conv_mc_convert(conv_layout from, const float *src, conv_layout to, float *dst, int N, int C, int H, int W);
+
+typedef struct conv_mc_kernel conv_mc_kernel;
+
+struct conv_mc_kernel {
+    int K, C, kH, kW;
+    conv_layout layout;
+    int Kp, Cp;          /* K and C rounded up to CONV_MC_BLOCK (nhwc: Kp only) */
+    float *packed;       /* the taps, arranged for the layout's engine */
+    const char *isa;
+    void (*row)(const conv_mc_kernel *k, const float *f, int H, int W, int n, int group, int i,
+                float *out, float *scratch);
+};
+
+/* Prepare g, K x C x kH x kW taps (row-major, [k][c][ki][kj]), for images
+   in the given layout. Returns 0, or -1 on bad sizes or allocation failure. */
+int conv_mc_kernel_init(conv_mc_kernel *k, conv_layout layout, const float *g, int K, int C, int kH, int kW);
+void conv_mc_kernel_free(conv_mc_kernel *k);
+
+/* out = k * f for N images of H x W, both in k->layout. Returns 0, or -1
+   on allocation failure. */
+int conv2d_mc(const conv_mc_kernel *k, const float *f, int N, int H, int W, float *out);
+
+#endif
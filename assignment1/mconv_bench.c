@@ -0,0 +1,249 @@
+/* mconv_bench.c - which image layout wins for multi-channel conv2d
+   Usage:
+     ./mconv_bench                       # default sweep on 1 x 64 x 64 images
+     ./mconv_bench -H 128 -W 128 -N 2    # other image sizes
+     ./mconv_bench 3,16,7,7 64,64,1,1    # chosen regimes, C,K,kH,kW each
+     ./mconv_bench --quick               # small sweep, for perfcheck
+
+   For every regime, each layout's conv2d_mc is timed on the same random
+   data and checked against the double engine run on every (k, c) plane
+   pair, which is also timed ("planes", the C*K single-channel calls this
+   replaces). "convert" is the cost of moving the input and output between
+   nchw and the winning layout, for callers whose data lives in nchw.
+   "roof" is the winner's fraction of the roofline bound (see roofline.h),
+   when a machine probe is available.
+   Exits 1 if any layout disagrees with the reference. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <omp.h>
+
+#include "../common/bench.h"
+#include "../common/roofline.h"
+#include "conv.h"
+
+typedef struct {
+    int C, K, kH, kW;
+} regime;
+
+static const regime default_regimes[] = {
+    { 1, 1, 3, 3 }, { 1, 1, 9, 9 }, { 3, 16, 3, 3 }, { 3, 16, 7, 7 }, { 16, 16, 3, 3 },
+    { 32, 32, 3, 3 }, { 64, 64, 3, 3 }, { 64, 64, 1, 1 }, { 128, 128, 1, 1 },
+};
+
+static const regime quick_regimes[] = {
+    { 1, 1, 3, 3 }, { 3, 16, 3, 3 }, { 17, 5, 4, 2 }, { 32, 32, 1, 1 },
+};
+
+/* bench_run wrappers */
+typedef struct {
+    const conv_mc_kernel *k;
+    const float *f;
+    float *out;
+    int N, H, W;
+} mc_args;
+
+static void run_conv2d_mc(void *p) {
+    mc_args *a = p;
+    conv2d_mc(a->k, a->f, a->N, a->H, a->W, a->out);
+}
+
+/* the double engine on each (k, c) pair, summed into ref */
+typedef struct {
+    double ***f;       /* [n * C + c] planes */
+    double ***g;       /* [k * C + c] kernels */
+    double **tmp;
+    double *ref;       /* nchw */
+    int N, C, K, H, W, kH, kW;
+} planes_args;
+
+static void run_planes(void *p) {
+    planes_args *a = p;
+    size_t plane = (size_t)a->H * a->W;
+    memset(a->ref, 0, sizeof(double) * a->N * a->K * plane);
+    for (int n = 0; n < a->N; ++n)
+        for (int o = 0; o < a->K; ++o)
+            for (int c = 0; c < a->C; ++c) {
+                conv2d_naive(a->f[n * a->C + c], a->H, a->W, a->g[o * a->C + c], a->kH, a->kW, a->tmp);
+                double *dst = &a->ref[((size_t)n * a->K + o) * plane];
+                for (int i = 0; i < a->H; ++i)
+                    for (int j = 0; j < a->W; ++j) dst[(size_t)i * a->W + j] += a->tmp[i][j];
+            }
+}
+
+typedef struct {
+    conv_layout to;
+    const float *f;
+    float *f_to, *out_to, *out;
+    int N, C, K, H, W;
+} convert_args;
+
+static void run_convert(void *p) {
+    convert_args *a = p;
+    conv_mc_convert(CONV_LAYOUT_NCHW, a->f, a->to, a->f_to, a->N, a->C, a->H, a->W);
+    conv_mc_convert(a->to, a->out_to, CONV_LAYOUT_NCHW, a->out, a->N, a->K, a->H, a->W);
+}
+
+/* Returns 0 if every layout matched the reference, 1 if not, -1 on allocation failure */
+static int run_regime(bench *bm, const bench_opts *opts, const roofline *roof, regime r, int N, int H, int W) {
+    int C = r.C, K = r.K;
+    size_t f_len = (size_t)N * C * H * W, out_len = (size_t)N * K * H * W;
+    size_t taps = (size_t)K * C * r.kH * r.kW;
+    float *f = malloc(sizeof(float) * f_len), *g = malloc(sizeof(float) * taps);
+    float *out = malloc(sizeof(float) * out_len);
+    double *ref = malloc(sizeof(double) * out_len);
+    double ***f_dp = calloc((size_t)N * C, sizeof(double **)), ***g_dp = calloc((size_t)K * C, sizeof(double **));
+    if (!f || !g || !out || !ref || !f_dp || !g_dp) return -1;
+
+    srand(1234);
+    for (size_t i = 0; i < f_len; ++i) f[i] = (float)rand() / RAND_MAX;
+    srand(5678);
+    for (size_t i = 0; i < taps; ++i) g[i] = (float)rand() / RAND_MAX - 0.5f;
+    double **tmp = conv_alloc_doubleptr_from_float_flat(f, H, W);
+    if (!tmp) return -1;
+    for (int p = 0; p < N * C; ++p)
+        if (!(f_dp[p] = conv_alloc_doubleptr_from_float_flat(&f[(size_t)p * H * W], H, W))) return -1;
+    for (int p = 0; p < K * C; ++p)
+        if (!(g_dp[p] = conv_alloc_doubleptr_from_float_flat(&g[(size_t)p * r.kH * r.kW], r.kH, r.kW))) return -1;
+
+    char name[128];
+    double flops = 2.0 * out_len * C * r.kH * r.kW;
+    bench_stats stats;
+    bench_opts once = *opts;
+    once.warmup = 0;
+    once.min_samples = 1;
+    planes_args planes = { f_dp, g_dp, tmp, ref, N, C, K, H, W, r.kH, r.kW };
+    snprintf(name, sizeof(name), "C%d_K%d_%dx%d/planes", C, K, r.kH, r.kW);
+    bench_run(bm, name, run_planes, &planes, &once, &stats);
+    double planes_time = stats.median;
+    double max_ref = 0.0;
+    for (size_t i = 0; i < out_len; ++i)
+        if (fabs(ref[i]) > max_ref) max_ref = fabs(ref[i]);
+
+    double best = 0.0, time[3];
+    conv_layout winner = CONV_LAYOUT_NCHW;
+    int bad = 0;
+    const char *isa = "";
+    printf("%4d %4d %3d %3d |", C, K, r.kH, r.kW);
+    for (conv_layout l = CONV_LAYOUT_NCHW; l <= CONV_LAYOUT_NCHWC; ++l) {
+        conv_mc_kernel k;
+        float *f_l = malloc(sizeof(float) * conv_mc_image_size(l, N, C, H, W));
+        float *out_l = malloc(sizeof(float) * conv_mc_image_size(l, N, K, H, W));
+        if (!f_l || !out_l || conv_mc_kernel_init(&k, l, g, K, C, r.kH, r.kW) != 0) return -1;
+        isa = k.isa;
+        conv_mc_convert(CONV_LAYOUT_NCHW, f, l, f_l, N, C, H, W);
+        mc_args args = { &k, f_l, out_l, N, H, W };
+        snprintf(name, sizeof(name), "C%d_K%d_%dx%d/%s", C, K, r.kH, r.kW, conv_layout_names[l]);
+        if (bench_run(bm, name, run_conv2d_mc, &args, opts, &stats) != 0) return -1;
+        time[l] = stats.median;
+        if (best == 0.0 || time[l] < best) { best = time[l]; winner = l; }
+
+        /* float sums of C*kH*kW terms against double ones */
+        conv_mc_convert(l, out_l, CONV_LAYOUT_NCHW, out, N, K, H, W);
+        double max_err = 0.0;
+        for (size_t i = 0; i < out_len; ++i)
+            if (fabs(out[i] - ref[i]) > max_err) max_err = fabs(out[i] - ref[i]);
+        int ok = max_err <= 1e-5 * (max_ref > 1.0 ? max_ref : 1.0) * sqrt((double)C * r.kH * r.kW);
+        if (!ok) {
+            fprintf(stderr, "C=%d K=%d %dx%d %s: max |err| %.3g against the double engine\n",
+                    C, K, r.kH, r.kW, conv_layout_names[l], max_err);
+            bad = 1;
+        }
+        printf(" %7.2f%s", flops / time[l] / 1e9, ok ? " " : "!");
+        conv_mc_kernel_free(&k);
+        free(f_l);
+        free(out_l);
+    }
+
+    double convert_time = 0.0;
+    if (winner != CONV_LAYOUT_NCHW) {
+        float *f_to = malloc(sizeof(float) * conv_mc_image_size(winner, N, C, H, W));
+        float *out_to = calloc(conv_mc_image_size(winner, N, K, H, W), sizeof(float));
+        if (!f_to || !out_to) return -1;
+        convert_args conv = { winner, f, f_to, out_to, out, N, C, K, H, W };
+        snprintf(name, sizeof(name), "C%d_K%d_%dx%d/convert_%s", C, K, r.kH, r.kW, conv_layout_names[winner]);
+        bench_run(bm, name, run_convert, &conv, opts, &stats);
+        convert_time = stats.median;
+        free(f_to);
+        free(out_to);
+    }
+    char roof_pct[8] = "    -";
+    if (roof) {
+        /* images in and out and the taps, once each */
+        double bytes = sizeof(float) * (double)(f_len + out_len + taps);
+        roofline_work work = { flops, bytes, (size_t)bytes, omp_get_max_threads(), 0 };
+        snprintf(roof_pct, sizeof(roof_pct), "%4.0f%%", 100.0 * flops / best / 1e9 / roofline_bound(roof, &work, NULL, 0));
+    }
+    printf("| %-5s %7.2fx %s | %10.3f | %6.2f  %s\n", conv_layout_names[winner], planes_time / best, roof_pct,
+           convert_time * 1e3, flops / planes_time / 1e9, isa);
+
+    for (int p = 0; p < N * C; ++p) conv_free_doubleptr_double(f_dp[p], H);
+    for (int p = 0; p < K * C; ++p) conv_free_doubleptr_double(g_dp[p], r.kH);
+    free(f_dp); free(g_dp); conv_free_doubleptr_double(tmp, H);
+    free(f); free(g); free(out); free(ref);
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    int N = 1, H = 64, W = 64, quick = 0;
+    struct option long_options[] = {
+        {"quick", no_argument, 0, 'q'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "N:H:W:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'N': N = atoi(optarg); break;
+            case 'H': H = atoi(optarg); break;
+            case 'W': W = atoi(optarg); break;
+            case 'q': quick = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-N n] [-H h] [-W w] [--quick] [C,K,kH,kW ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (quick && H == 64 && W == 64) H = W = 24;
+    if (N <= 0 || H <= 0 || W <= 0) { fprintf(stderr, "Image sizes must be positive\n"); return 1; }
+
+    int count = argc - optind;
+    regime *regimes = malloc(sizeof(regime) * (count ? count : 1));
+    if (!regimes) { perror("malloc"); return 1; }
+    for (int i = 0; i < count; ++i) {
+        regime *r = &regimes[i];
+        if (sscanf(argv[optind + i], "%d,%d,%d,%d", &r->C, &r->K, &r->kH, &r->kW) != 4 ||
+            r->C <= 0 || r->K <= 0 || r->kH <= 0 || r->kW <= 0) {
+            fprintf(stderr, "Bad regime '%s', expected C,K,kH,kW\n", argv[optind + i]);
+            return 1;
+        }
+    }
+    const regime *list = regimes;
+    if (!count) {
+        list = quick ? quick_regimes : default_regimes;
+        count = quick ? (int)(sizeof(quick_regimes) / sizeof(quick_regimes[0]))
+                      : (int)(sizeof(default_regimes) / sizeof(default_regimes[0]));
+    }
+
+    bench *bm = bench_create("mconv_bench");
+    roofline *roof = roofline_open(NULL);
+    bench_opts opts = bench_default_opts();
+    opts.min_samples = 3;
+    opts.min_sample = 0.002;
+    opts.max_total = quick ? 0.05 : 0.3;
+
+    printf("Images %d x %d x %d; GFLOP/s per layout, winner with its speed-up over the\n", N, H, W);
+    printf("C*K single-plane double calls, nchw <-> winner conversion of f and out in ms\n");
+    printf("   C    K  kH  kW |    nchw     nhwc    nchwc  | best   vs planes  roof | convert ms | planes\n");
+    int status = 0;
+    for (int i = 0; i < count; ++i) {
+        int rc = run_regime(bm, &opts, roof, list[i], N, H, W);
+        if (rc < 0) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+        if (rc) status = 1;
+    }
+    bench_destroy(bm);
+    roofline_close(roof);
+    free(regimes);
+    return status;
+}
@@ -0,0 +1,209 @@
+#include "quant.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+conv_quant_params conv_quant_params_for_range(float lo, float hi) {
+    if (lo > 0.0f) lo = 0.0f;
+    if (hi < 0.0f) hi = 0.0f;
+    conv_quant_params p;
+    p.scale = hi > lo ? (hi - lo) / 255.0f : 1.0f;
+    p.zero_point = (int)lrintf(-lo / p.scale);
+    if (p.zero_point < 0) p.zero_point = 0;
+    if (p.zero_point > 255) p.zero_point = 255;
+    return p;
+}
+
+void conv_quantize_u8(const float *x, size_t n, conv_quant_params p, uint8_t *q) {
+    float inv = 1.0f / p.scale;
+    for (size_t i = 0; i < n; ++i) {
+        long v = p.zero_point + lrintf(x[i] * inv);
+        q[i] = v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+    }
+}
+
+void conv_dequantize_u8(const uint8_t *q, size_t n, conv_quant_params p, float *x) {
+    for (size_t i = 0; i < n; ++i) x[i] = p.scale * (q[i] - p.zero_point);
+}
+
+/* ---- row kernels ---- */
+
+static void row_scalar(const int32_t *packed, int groups, const int16_t *q, int kW,
+                       const uint8_t *src, int32_t *acc, int n) {
+    (void)packed; (void)groups;
+    for (int kj = 0; kj < kW; ++kj) {
+        int32_t w = q[kj];
+        for (int j = 0; j < n; ++j) acc[j] += w * src[j + kj];
+    }
+}
+
+/* scalar finish for the columns a SIMD loop left over */
+static void row_tail(const int16_t *q, int kW, const uint8_t *src, int32_t *acc, int j, int n) {
+    if (j < n) row_scalar(NULL, 0, q, kW, src + j, acc + j, n - j);
+}
+
+/* groups of 4 taps, one int8 each; 16 output pixels per vpdpbusd */
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void row_vnni(const int32_t *packed, int groups, const int16_t *q, int kW,
+                     const uint8_t *src, int32_t *acc, int n) {
+    /* lane k takes dwords k..k+3, i.e. source bytes 4k..4k+15, and the byte
+       shuffle then gives output pixel 4k+m the bytes 4k+m..4k+m+3 */
+    const __m512i spread = _mm512_setr_epi32(0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6);
+    const __m512i window = _mm512_set4_epi32(0x06050403, 0x05040302, 0x04030201, 0x03020100);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m512i sum = _mm512_loadu_si512(&acc[j]);
+        for (int g = 0; g < groups; ++g) {
+            __m512i v = _mm512_zextsi256_si512(_mm256_loadu_si256((const __m256i *)&src[j + 4 * g]));
+            __m512i x = _mm512_shuffle_epi8(_mm512_permutexvar_epi32(spread, v), window);
+            sum = _mm512_dpbusd_epi32(sum, x, _mm512_set1_epi32(packed[g]));
+        }
+        _mm512_storeu_si512(&acc[j], sum);
+    }
+    row_tail(q, kW, src, acc, j, n);
+}
+
+/* pairs of taps, one int8 each (|q| <= 63); 32 output pixels per step */
+__attribute__((target("avx2")))
+static void row_maddubs(const int32_t *packed, int groups, const int16_t *q, int kW,
+                        const uint8_t *src, int32_t *acc, int n) {
+    int j = 0;
+    for (; j + 32 <= n; j += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)&acc[j]);
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)&acc[j + 8]);
+        __m256i a2 = _mm256_loadu_si256((const __m256i *)&acc[j + 16]);
+        __m256i a3 = _mm256_loadu_si256((const __m256i *)&acc[j + 24]);
+        for (int g = 0; g < groups; ++g) {
+            const uint8_t *p = &src[j + 2 * g];
+            __m256i x = _mm256_loadu_si256((const __m256i *)p);
+            __m256i y = _mm256_loadu_si256((const __m256i *)(p + 1));
+            __m256i w = _mm256_set1_epi16((int16_t)packed[g]);
+            /* unpack works per 128-bit lane: lo holds pixels 0-7 and 16-23, hi 8-15 and 24-31 */
+            __m256i lo = _mm256_maddubs_epi16(_mm256_unpacklo_epi8(x, y), w);
+            __m256i hi = _mm256_maddubs_epi16(_mm256_unpackhi_epi8(x, y), w);
+            a0 = _mm256_add_epi32(a0, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(lo)));
+            a2 = _mm256_add_epi32(a2, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(lo, 1)));
+            a1 = _mm256_add_epi32(a1, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(hi)));
+            a3 = _mm256_add_epi32(a3, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(hi, 1)));
+        }
+        _mm256_storeu_si256((__m256i *)&acc[j], a0);
+        _mm256_storeu_si256((__m256i *)&acc[j + 8], a1);
+        _mm256_storeu_si256((__m256i *)&acc[j + 16], a2);
+        _mm256_storeu_si256((__m256i *)&acc[j + 24], a3);
+    }
+    row_tail(q, kW, src, acc, j, n);
+}
+
+/* pairs of taps, one int16 each, on pixels widened to int16; 16 pixels per step */
+__attribute__((target("avx2")))
+static void row_madd(const int32_t *packed, int groups, const int16_t *q, int kW,
+                     const uint8_t *src, int32_t *acc, int n) {
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        /* s0 collects pixels 0-3 and 8-11, s1 pixels 4-7 and 12-15 */
+        __m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+        for (int g = 0; g < groups; ++g) {
+            const uint8_t *p = &src[j + 2 * g];
+            __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+            __m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p + 1)));
+            __m256i w = _mm256_set1_epi32(packed[g]);
+            s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi16(x, y), w));
+            s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi16(x, y), w));
+        }
+        __m256i lo = _mm256_loadu_si256((const __m256i *)&acc[j]);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)&acc[j + 8]);
+        _mm256_storeu_si256((__m256i *)&acc[j], _mm256_add_epi32(lo, _mm256_permute2x128_si256(s0, s1, 0x20)));
+        _mm256_storeu_si256((__m256i *)&acc[j + 8], _mm256_add_epi32(hi, _mm256_permute2x128_si256(s0, s1, 0x31)));
+    }
+    row_tail(q, kW, src, acc, j, n);
+}
+
+/* ---- kernel setup ---- */
+
+static int isa_allowed(const char *name) {
+    const char *want = getenv("CONV_QUANT_ISA");
+    if (!want || !*want) return 1;
+    return strcmp(want, name) == 0;
+}
+
+int conv_quant_kernel_init(conv_quant_kernel *k, const float *g, int kH, int kW, int bits) {
+    memset(k, 0, sizeof(*k));
+    if (bits < 2 || bits > 16 || kH <= 0 || kW <= 0) return -1;
+    int n = kH * kW;
+    int qmax = (1 << (bits - 1)) - 1;
+    double max_abs = 0.0, sum_abs = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double a = fabs(g[i]);
+        if (a > max_abs) max_abs = a;
+        sum_abs += a;
+    }
+    double scale = max_abs > 0.0 ? max_abs / qmax : 1.0;
+    /* keep 255 * sum |q| within an int32 */
+    if (sum_abs > 0.0 && 255.0 * sum_abs / scale > 2147483647.0) scale = 255.0 * sum_abs / 2147483647.0;
+
+    k->kH = kH;
+    k->kW = kW;
+    k->bits = bits;
+    k->scale = (float)scale;
+    k->q = malloc(sizeof(int16_t) * n);
+    k->row_sum = malloc(sizeof(int32_t) * kH);
+    if (!k->q || !k->row_sum) { conv_quant_kernel_free(k); return -1; }
+    int q_max_abs = 0;
+    for (int ki = 0; ki < kH; ++ki) {
+        k->row_sum[ki] = 0;
+        for (int kj = 0; kj < kW; ++kj) {
+            long v = lrint(g[ki * kW + kj] / scale);
+            if (v > qmax) v = qmax;
+            if (v < -qmax) v = -qmax;
+            k->q[ki * kW + kj] = (int16_t)v;
+            k->row_sum[ki] += v;
+            if (labs(v) > q_max_abs) q_max_abs = labs(v);
+        }
+    }
+
+    __builtin_cpu_init();
+    int vnni = __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw");
+    int avx2 = __builtin_cpu_supports("avx2");
+    if (vnni && q_max_abs <= 127 && isa_allowed("vnni")) {
+        k->isa = "AVX-512 VNNI";
+        k->step = 4;
+        k->row = row_vnni;
+    } else if (avx2 && q_max_abs <= 63 && (isa_allowed("avx2") || isa_allowed("maddubs"))) {
+        k->isa = "AVX2 maddubs";
+        k->step = 2;
+        k->row = row_maddubs;
+    } else if (avx2 && (isa_allowed("avx2") || isa_allowed("madd"))) {
+        k->isa = "AVX2 madd";
+        k->step = 2;
+        k->row = row_madd;
+    } else {
+        k->isa = "scalar";
+        k->step = 1;
+        k->row = row_scalar;
+    }
+
+    /* pack each kernel row into groups of step taps, zero padded at the end */
+    k->groups = (kW + k->step - 1) / k->step;
+    k->packed = calloc((size_t)kH * k->groups, sizeof(int32_t));
+    if (!k->packed) { conv_quant_kernel_free(k); return -1; }
+    for (int ki = 0; ki < kH; ++ki)
+        for (int kj = 0; kj < kW; ++kj) {
+            int16_t v = k->q[ki * kW + kj];
+            int32_t *dst = &k->packed[(size_t)ki * k->groups + kj / k->step];
+            int slot = kj % k->step;
+            if (k->row == row_madd) *dst |= (int32_t)((uint32_t)(uint16_t)v << (16 * slot));
+            else *dst |= (int32_t)((uint32_t)(uint8_t)v << (8 * slot));
+        }
+    return 0;
+}
+
+void conv_quant_kernel_free(conv_quant_kernel *k) {
+    free(k->q);
+    free(k->row_sum);
+    free(k->packed);
+    k->q = NULL;
+    k->row_sum = NULL;
+    k->packed = NULL;
+}
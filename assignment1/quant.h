@@ -0,0 +1,58 @@
+#ifndef QUANT_H
+#define QUANT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 8-bit affine quantisation for images: real = scale * (q - zero_point),
+   q in 0..255, with 0.0 always exactly representable so zero padding stays
+   exact. */
+typedef struct {
+    float scale;
+    int zero_point;
+} conv_quant_params;
+
+/* Parameters covering [lo, hi], widened to include 0 */
+conv_quant_params conv_quant_params_for_range(float lo, float hi);
+
+void conv_quantize_u8(const float *x, size_t n, conv_quant_params p, uint8_t *q);
+void conv_dequantize_u8(const uint8_t *q, size_t n, conv_quant_params p, float *x);
+
+/* Fixed-point kernel: real tap = scale * q with q a signed integer of the
+   given bit width (2..16), symmetric around zero. The scale is also bounded
+   so that 255 * sum |q| fits an int32 accumulator.
+
+   conv_quant_kernel_init picks the row kernel for the CPU; for testing,
+   CONV_QUANT_ISA=vnni|avx2|maddubs|madd|scalar restricts the choice:
+     vnni     AVX-512 VNNI vpdpbusd, 4 taps per instruction, up to 8 bits
+     maddubs  AVX2 vpmaddubsw, 2 taps per instruction; its int16 pair sums
+              saturate unless |q| <= 63, so only for kernels up to 7 bits
+     madd     AVX2 vpmaddwd on pixels widened to int16, any width
+     scalar   portable C */
+typedef struct {
+    int kH, kW, bits;
+    float scale;
+    int16_t *q;          /* kH*kW taps, row-major */
+    int32_t *row_sum;    /* sum of q over each kernel row */
+    const char *isa;
+    int step;            /* taps per packed group: 4 (vnni), 2 (maddubs, madd), 1 (scalar) */
+    int groups;          /* packed groups per kernel row */
+    int32_t *packed;     /* kH*groups weight groups in the layout the row kernel reads */
+    void (*row)(const int32_t *packed, int groups, const int16_t *q, int kW,
+                const uint8_t *src, int32_t *acc, int n);
+} conv_quant_kernel;
+
+/* Returns 0, or -1 on bad bits or allocation failure */
+int conv_quant_kernel_init(conv_quant_kernel *k, const float *g, int kH, int kW, int bits);
+void conv_quant_kernel_free(conv_quant_kernel *k);
+
+/* Bytes a row kernel may read past src[n + kW - 1] */
+#define CONV_QUANT_ROW_SLACK 64
+
+/* acc[j] += sum over kj of q[ki][kj] * src[j + kj], for j in [0, n).
+   src must stay readable CONV_QUANT_ROW_SLACK bytes beyond src[n + kW - 1]. */
+static inline void quant_row_accumulate(const conv_quant_kernel *k, int ki, const uint8_t *src, int32_t *acc, int n) {
+    k->row(&k->packed[(size_t)ki * k->groups], k->groups, &k->q[(size_t)ki * k->kW], k->kW, src, acc, n);
+}
+
+#endif
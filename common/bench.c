@@ -0,0 +1,217 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define BENCH_MAX_DEPTH 16
+#define BENCH_MAX_CALLS (1 << 24)
+
+typedef struct {
+    char name[128];
+    double wall, cpu, thread;
+} bench_timer;
+
+struct bench {
+    char suite[64];
+    bench_timer stack[BENCH_MAX_DEPTH];
+    int depth;
+    int overflow;   // bench_start calls past BENCH_MAX_DEPTH, not pushed
+    bench_stats *results;
+    int num_results, cap_results;
+};
+
+static double clock_seconds(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double bench_wall(void) { return clock_seconds(CLOCK_MONOTONIC); }
+double bench_cpu(void) { return clock_seconds(CLOCK_PROCESS_CPUTIME_ID); }
+double bench_thread(void) { return clock_seconds(CLOCK_THREAD_CPUTIME_ID); }
+
+bench_opts bench_default_opts(void) {
+    bench_opts o = { 1, 5, 100, 0.01, 1.0, 3.0 };
+    return o;
+}
+
+bench *bench_create(const char *suite) {
+    bench *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    snprintf(b->suite, sizeof(b->suite), "%s", suite);
+    return b;
+}
+
+static void write_csv(const bench *b, const char *path) {
+    int is_new = access(path, F_OK) != 0;
+    FILE *fp = fopen(path, "a");
+    if (!fp) { perror(path); return; }
+    if (is_new)
+        fprintf(fp, "suite,name,samples,rejected,calls_per_sample,median,mean,stddev,min,max,cpu,caller_cpu\n");
+    for (int i = 0; i < b->num_results; i++) {
+        const bench_stats *s = &b->results[i];
+        fprintf(fp, "\"%s\",\"%s\",%d,%d,%d,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e,%.9e\n",
+                b->suite, s->name, s->samples, s->rejected, s->calls_per_sample,
+                s->median, s->mean, s->stddev, s->min, s->max, s->cpu, s->caller_cpu);
+    }
+    fclose(fp);
+}
+
+void bench_destroy(bench *b) {
+    if (!b) return;
+    const char *path = getenv("BENCH_OUTPUT");
+    if (path && *path) write_csv(b, path);
+    free(b->results);
+    free(b);
+}
+
+static void record(bench *b, const bench_stats *s) {
+    if (b->num_results == b->cap_results) {
+        int cap = b->cap_results ? 2 * b->cap_results : 16;
+        bench_stats *r = realloc(b->results, sizeof(*r) * cap);
+        if (!r) return;
+        b->results = r;
+        b->cap_results = cap;
+    }
+    b->results[b->num_results++] = *s;
+}
+
+/* "outer/inner" for nested timers */
+static void qualified_name(const bench *b, const char *name, char *out, size_t size) {
+    if (b->depth > 0) snprintf(out, size, "%s/%s", b->stack[b->depth - 1].name, name);
+    else snprintf(out, size, "%s", name);
+}
+
+void bench_start(bench *b, const char *name) {
+    if (b->depth == BENCH_MAX_DEPTH) { b->overflow++; return; }
+    char full[sizeof(b->stack[0].name)];
+    qualified_name(b, name, full, sizeof(full));
+    bench_timer *t = &b->stack[b->depth++];
+    memcpy(t->name, full, sizeof(full));
+    t->cpu = bench_cpu();
+    t->thread = bench_thread();
+    t->wall = bench_wall();
+}
+
+bench_stats bench_stop(bench *b) {
+    double wall = bench_wall(), cpu = bench_cpu(), thread = bench_thread();
+    bench_stats s;
+    memset(&s, 0, sizeof(s));
+    if (b->overflow) { b->overflow--; return s; } // matches an unpushed bench_start
+    if (b->depth == 0) return s;
+
+    bench_timer *t = &b->stack[--b->depth];
+    memcpy(s.name, t->name, sizeof(s.name));
+    s.samples = s.calls_per_sample = 1;
+    s.median = s.mean = s.min = s.max = wall - t->wall;
+    s.cpu = cpu - t->cpu;
+    s.caller_cpu = thread - t->thread;
+    record(b, &s);
+    return s;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double *v, int n) {
+    qsort(v, n, sizeof(double), cmp_double);
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+int bench_run(bench *b, const char *name, void (*fn)(void *), void *arg,
+              const bench_opts *opts, bench_stats *out) {
+    bench_opts defaults = bench_default_opts();
+    if (!opts) opts = &defaults;
+
+    for (int i = 0; i < opts->warmup; i++) fn(arg);
+
+    // calibrate: grow the batch until one batch lasts min_sample
+    int calls = 1;
+    for (;;) {
+        double t0 = bench_wall();
+        for (int i = 0; i < calls; i++) fn(arg);
+        double t = bench_wall() - t0;
+        if (t >= opts->min_sample || calls >= BENCH_MAX_CALLS) break;
+        double grow = t > 0 ? 1.2 * opts->min_sample / t : 100.0;
+        if (grow < 2) grow = 2;
+        if (grow > 100) grow = 100;
+        calls = (calls * grow < BENCH_MAX_CALLS) ? (int)(calls * grow) : BENCH_MAX_CALLS;
+    }
+
+    int max_samples = opts->max_samples > opts->min_samples ? opts->max_samples : opts->min_samples;
+    double *wall = malloc(sizeof(double) * max_samples * 3);
+    if (!wall) return -1;
+    double *cpu = wall + max_samples, *thread = cpu + max_samples;
+
+    int n = 0;
+    double spent = 0.0;
+    while (n < max_samples && (n < opts->min_samples || spent < opts->max_total)) {
+        double c0 = bench_cpu(), th0 = bench_thread(), w0 = bench_wall();
+        for (int i = 0; i < calls; i++) fn(arg);
+        double w1 = bench_wall();
+        wall[n] = (w1 - w0) / calls;
+        cpu[n] = (bench_cpu() - c0) / calls;
+        thread[n] = (bench_thread() - th0) / calls;
+        spent += w1 - w0;
+        n++;
+    }
+
+    bench_stats s;
+    memset(&s, 0, sizeof(s));
+    qualified_name(b, name, s.name, sizeof(s.name));
+    s.calls_per_sample = calls;
+
+    // outliers: more than k scaled median absolute deviations from the median
+    double *sorted = malloc(sizeof(double) * n);
+    if (!sorted) { free(wall); return -1; }
+    memcpy(sorted, wall, sizeof(double) * n);
+    double med = median_of(sorted, n);
+    for (int i = 0; i < n; i++) sorted[i] = fabs(wall[i] - med);
+    double mad = 1.4826 * median_of(sorted, n);
+
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (opts->outlier_k > 0 && mad > 0 && fabs(wall[i] - med) > opts->outlier_k * mad) continue;
+        wall[kept] = wall[i];
+        cpu[kept] = cpu[i];
+        thread[kept] = thread[i];
+        kept++;
+    }
+    s.samples = kept;
+    s.rejected = n - kept;
+
+    double sum = 0.0, sq = 0.0;
+    s.min = INFINITY;
+    s.max = 0.0;
+    for (int i = 0; i < kept; i++) {
+        sum += wall[i];
+        if (wall[i] < s.min) s.min = wall[i];
+        if (wall[i] > s.max) s.max = wall[i];
+    }
+    s.mean = sum / kept;
+    for (int i = 0; i < kept; i++) sq += (wall[i] - s.mean) * (wall[i] - s.mean);
+    s.stddev = kept > 1 ? sqrt(sq / (kept - 1)) : 0.0;
+    s.median = median_of(wall, kept);
+    s.cpu = median_of(cpu, kept);
+    s.caller_cpu = median_of(thread, kept);
+
+    free(sorted);
+    free(wall);
+    record(b, &s);
+    if (out) *out = s;
+    return 0;
+}
+
+void bench_report(const bench *b, FILE *fp) {
+    fprintf(fp, "%-40s %8s %12s %12s %12s %12s\n", b->suite, "samples", "median", "stddev", "cpu", "caller cpu");
+    for (int i = 0; i < b->num_results; i++) {
+        const bench_stats *s = &b->results[i];
+        fprintf(fp, "%-40s %8d %12.6e %12.6e %12.6e %12.6e\n",
+                s->name, s->samples, s->median, s->stddev, s->cpu, s->caller_cpu);
+    }
+}
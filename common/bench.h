@@ -0,0 +1,64 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+/* Small benchmarking library shared by the labs and conv_test.
+
+   All state lives in a bench context, so separate contexts can be used from
+   separate threads; a single context must not be shared between threads.
+
+   Two ways to time something:
+     - bench_start / bench_stop: one sample of a region. Timers nest, and a
+       nested timer is recorded as "outer/inner". Timers nested deeper than
+       16 levels are not recorded, and their bench_stop returns zeroes.
+     - bench_run: warm up, calibrate how many calls make one sample last at
+       least min_sample seconds, take samples until max_total is spent, drop
+       outliers and summarise.
+
+   Every result is kept in the context. If BENCH_OUTPUT is set, bench_destroy
+   appends them to that file as CSV (header written when the file is new):
+     suite,name,samples,rejected,calls_per_sample,median,mean,stddev,min,max,cpu,caller_cpu
+   with all times in seconds per call. */
+
+typedef struct {
+    int warmup;         /* untimed calls before measuring (default 1) */
+    int min_samples;    /* at least this many samples (default 5) */
+    int max_samples;    /* at most this many samples (default 100) */
+    double min_sample;  /* seconds each sample should last, calls are batched to reach it (default 0.01) */
+    double max_total;   /* stop sampling after this many seconds (default 1.0) */
+    double outlier_k;   /* reject samples over k scaled MADs from the median, 0 disables (default 3) */
+} bench_opts;
+
+typedef struct {
+    char name[128];
+    int samples, rejected, calls_per_sample;
+    double median, mean, stddev, min, max; /* wall seconds per call, outliers excluded */
+    double cpu;                            /* median process CPU seconds per call, all threads */
+    double caller_cpu;                     /* the same for the calling thread only, which
+                                              leaves out the other OpenMP threads' work */
+} bench_stats;
+
+typedef struct bench bench;
+
+bench_opts bench_default_opts(void);
+
+bench *bench_create(const char *suite);
+void bench_destroy(bench *b);
+
+void bench_start(bench *b, const char *name);
+bench_stats bench_stop(bench *b);
+
+/* Time fn(arg). opts may be NULL for the defaults. Returns 0, or -1 on allocation failure. */
+int bench_run(bench *b, const char *name, void (*fn)(void *), void *arg,
+              const bench_opts *opts, bench_stats *out);
+
+/* Human-readable table of every result so far */
+void bench_report(const bench *b, FILE *fp);
+
+/* Wall, process CPU and calling-thread CPU clocks in seconds */
+double bench_wall(void);
+double bench_cpu(void);
+double bench_thread(void);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+/* Adaptive Gauss-Kronrod (G7/K15) integration on OpenMP tasks.
+
+   The integrand is evaluated in batches: one call receives all 15 Kronrod
+   nodes of an interval, so implementations can use an omp simd loop. An
+   interval whose error estimate exceeds its share of the tolerance is split
+   in two and each half becomes a task; idle threads pick up (steal) the
+   pending tasks of busy ones through the OpenMP runtime's task queues. */
+
+typedef void (*integrand_batch)(const double *x, double *y, int n, void *ctx);
+
+typedef struct {
+    double abs_tol;     /* stop when the total error estimate is below this */
+    int max_depth;      /* bisection limit, intervals at this depth are accepted */
+    int task_max_depth; /* deeper intervals recurse inside their parent's task */
+} integrate_opts;
+
+typedef struct {
+    double value;
+    double error;       /* sum of the accepted intervals' error estimates */
+    long evaluations;   /* integrand points evaluated */
+    long intervals;     /* accepted leaf intervals */
+} integrate_result;
+
+/* abs_tol 1e-10, max_depth 50, task_max_depth 16 */
+integrate_opts integrate_default_opts(void);
+
+/* Integrate f over [a, b]. Call from serial code: opens its own parallel region. */
+integrate_result integrate_adaptive(integrand_batch f, void *ctx, double a, double b,
+                                    const integrate_opts *opts);
+
+#endif
@@ -0,0 +1,258 @@
+/* machine_probe.c - measure the machine ceilings that roofline.h reports against
+   Usage:
+     ./machine_probe               # write machine_probe.txt ($MACHINE_PROBE if set)
+     ./machine_probe -o probe.txt  # somewhere else
+     ./machine_probe --quick       # shorter samples, rougher numbers
+
+   Bandwidth: the four STREAM kernels, on three arrays of doubles sized to
+   fill half of each cache level (per thread for L1 and L2, shared for L3)
+   and to overflow the last level several times for DRAM. Each thread works
+   on its own slice, first touched by that thread, and repeats it inside
+   one parallel region so small levels are not swamped by fork/join costs.
+   The best sample counts, as in STREAM.
+
+   Peak: independent multiply-add chains per ISA in float and double, FMA
+   where the ISA has it. "scalar" and "sse2" are what code built without
+   -march gets, "avx2" and "avx512" what the CPU can do.
+
+   Both are measured at 1, 2, 4 ... threads up to omp_get_max_threads(). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <omp.h>
+
+#include "bench.h"
+#include "roofline.h"
+
+#define PROBE_DRAM_MIN (64L << 20)   // smallest DRAM working set, bytes
+#define PROBE_DRAM_MAX (512L << 20)
+#define PROBE_CALL_BYTES (4L << 20)  // traffic per thread per timed call
+#define PEAK_ITERS (1 << 16)
+
+// ---------------------------------------------------------------- bandwidth
+
+typedef struct {
+    double *a, *b, *c;
+    long n;         // doubles per thread
+    int threads, reps;
+    stream_kernel kernel;
+} stream_args;
+
+// Cloned for the widest vectors the CPU has: SSE2 loads and stores would
+// cap the cache levels well below what tuned code reaches
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static void stream_pass(stream_kernel kernel, double *a, double *b, double *c, long n, int reps) {
+    const double q = 3.0;
+    for (int r = 0; r < reps; r++) {
+        switch (kernel) {
+            case STREAM_COPY:  for (long i = 0; i < n; i++) c[i] = a[i]; break;
+            case STREAM_SCALE: for (long i = 0; i < n; i++) b[i] = q * c[i]; break;
+            case STREAM_ADD:   for (long i = 0; i < n; i++) c[i] = a[i] + b[i]; break;
+            case STREAM_TRIAD: for (long i = 0; i < n; i++) a[i] = b[i] + q * c[i]; break;
+        }
+        __asm__ volatile("" ::: "memory"); // every pass really runs
+    }
+}
+
+static void run_stream(void *p) {
+    stream_args *s = p;
+    #pragma omp parallel num_threads(s->threads)
+    {
+        long lo = s->n * omp_get_thread_num();
+        stream_pass(s->kernel, s->a + lo, s->b + lo, s->c + lo, s->n, s->reps);
+    }
+}
+
+// GB/s of each kernel with n doubles per array per thread
+static int measure_stream(bench *bm, const bench_opts *opts, const char *level, long n, int threads, double *gbs) {
+    n = (n + 7) & ~7L; // whole cache lines per slice
+    size_t size = sizeof(double) * n * threads;
+    stream_args s = { aligned_alloc(64, size), aligned_alloc(64, size), aligned_alloc(64, size), n, threads, 1, 0 };
+    if (!s.a || !s.b || !s.c) return -1;
+    #pragma omp parallel num_threads(threads)
+    {
+        long lo = n * omp_get_thread_num();
+        for (long i = lo; i < lo + n; i++) { s.a[i] = 1.0; s.b[i] = 2.0; s.c[i] = 0.0; }
+    }
+    for (int k = 0; k < STREAM_KERNELS; k++) {
+        s.kernel = k;
+        s.reps = PROBE_CALL_BYTES / (stream_bytes[k] * n) + 1;
+        char name[64];
+        snprintf(name, sizeof(name), "%s/%s/%d", level, stream_names[k], threads);
+        bench_stats stats;
+        if (bench_run(bm, name, run_stream, &s, opts, &stats) != 0) return -1;
+        gbs[k] = (double)stream_bytes[k] * n * threads * s.reps / stats.min / 1e9;
+    }
+    free(s.a); free(s.b); free(s.c);
+    return 0;
+}
+
+// ---------------------------------------------------------------- peak
+
+/* PEAK_ACCS chains of x = x * m + a, enough to cover the FMA latency on
+   two pipes. The empty asm keeps each accumulator in its own register, so
+   the scalar version is not vectorised behind our back. */
+#define PEAK_ACCS 12
+#define PEAK_STEP(x) x = x * m + a; __asm__("" : "+v"(x))
+
+#define PEAK_KERNEL(fn, type, vec, attr)                                               \
+attr static double fn(long iters) {                                                    \
+    type m = 0.999999, a = 1e-6;                                                       \
+    vec x0 = (vec){0} + m, x1 = x0 + a, x2 = x0 - a, x3 = x1 + a, x4 = x2 - a;           \
+    vec x5 = x3 + a, x6 = x4 - a, x7 = x5 + a, x8 = x6 - a, x9 = x7 + a, x10 = x8 - a;   \
+    vec x11 = x9 + a;                                                                  \
+    for (long i = 0; i < iters; i++) {                                                 \
+        PEAK_STEP(x0); PEAK_STEP(x1); PEAK_STEP(x2); PEAK_STEP(x3);                    \
+        PEAK_STEP(x4); PEAK_STEP(x5); PEAK_STEP(x6); PEAK_STEP(x7);                    \
+        PEAK_STEP(x8); PEAK_STEP(x9); PEAK_STEP(x10); PEAK_STEP(x11);                  \
+    }                                                                                  \
+    vec s = x0 + x1 + x2 + x3 + x4 + x5 + x6 + x7 + x8 + x9 + x10 + x11;               \
+    const type *lane = (const type *)&s;                                               \
+    double sum = 0.0;                                                                  \
+    for (int i = 0; i < (int)(sizeof(vec) / sizeof(type)); i++) sum += lane[i];        \
+    return sum;                                                                        \
+}
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef double v2d __attribute__((vector_size(16)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef double v4d __attribute__((vector_size(32)));
+typedef float v16f __attribute__((vector_size(64)));
+typedef double v8d __attribute__((vector_size(64)));
+
+PEAK_KERNEL(peak_scalar_f32, float, float, )
+PEAK_KERNEL(peak_scalar_f64, double, double, )
+PEAK_KERNEL(peak_sse2_f32, float, v4f, )
+PEAK_KERNEL(peak_sse2_f64, double, v2d, )
+PEAK_KERNEL(peak_avx2_f32, float, v8f, __attribute__((target("avx2,fma"))))
+PEAK_KERNEL(peak_avx2_f64, double, v4d, __attribute__((target("avx2,fma"))))
+PEAK_KERNEL(peak_avx512_f32, float, v16f, __attribute__((target("avx512f"))))
+PEAK_KERNEL(peak_avx512_f64, double, v8d, __attribute__((target("avx512f"))))
+
+typedef struct {
+    const char *name;
+    int lanes[2];                   // per vector, float and double
+    double (*kernel[2])(long);
+} peak_isa;
+
+static const peak_isa isas[] = {
+    { "scalar", { 1, 1 },  { peak_scalar_f32, peak_scalar_f64 } },
+    { "sse2",   { 4, 2 },  { peak_sse2_f32, peak_sse2_f64 } },
+    { "avx2",   { 8, 4 },  { peak_avx2_f32, peak_avx2_f64 } },
+    { "avx512", { 16, 8 }, { peak_avx512_f32, peak_avx512_f64 } },
+};
+
+static int isa_supported(int i) {
+    if (i == 2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (i == 3) return __builtin_cpu_supports("avx512f");
+    return 1;
+}
+
+typedef struct {
+    double (*kernel)(long);
+    int threads;
+    double sink;
+} peak_args;
+
+static void run_peak(void *p) {
+    peak_args *a = p;
+    double sink = 0.0;
+    #pragma omp parallel num_threads(a->threads) reduction(+:sink)
+    sink += a->kernel(PEAK_ITERS);
+    a->sink += sink;
+}
+
+// ---------------------------------------------------------------- main
+
+int main(int argc, char **argv) {
+    const char *out = getenv("MACHINE_PROBE");
+    if (!out || !*out) out = "machine_probe.txt";
+    int quick = 0;
+    struct option long_options[] = {
+        {"quick", no_argument, 0, 'q'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "o:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'o': out = optarg; break;
+            case 'q': quick = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-o file] [--quick]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    roofline r;
+    memset(&r, 0, sizeof(r));
+    int max_threads = omp_get_max_threads();
+    for (int t = 1; r.num_counts < ROOFLINE_MAX_COUNTS; t *= 2) {
+        r.threads[r.num_counts++] = t < max_threads ? t : max_threads;
+        if (t >= max_threads) break;
+    }
+
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE), l2 = sysconf(_SC_LEVEL2_CACHE_SIZE), l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l1 <= 0) l1 = 32 * 1024;
+    if (l2 <= 0) l2 = 1024 * 1024;
+    const char *names[] = { "L1", "L2", "L3", "DRAM" };
+    long sizes[] = { l1, l2, l3 > 0 ? l3 : 0, 0 };
+    for (int l = 0; l < 4; l++) {
+        if (l == 2 && sizes[l] == 0) continue;
+        snprintf(r.level[r.num_levels], sizeof(r.level[0]), "%s", names[l]);
+        r.capacity[r.num_levels++] = sizes[l];
+    }
+    long dram = 4 * (l3 > 0 ? l3 : l2);
+    if (dram < PROBE_DRAM_MIN) dram = PROBE_DRAM_MIN;
+    if (dram > PROBE_DRAM_MAX) dram = PROBE_DRAM_MAX;
+
+    bench *bm = bench_create("machine_probe");
+    bench_opts opts = bench_default_opts();
+    opts.min_samples = quick ? 3 : 5;
+    opts.min_sample = quick ? 0.002 : 0.01;
+    opts.max_total = quick ? 0.02 : 0.2;
+
+    printf("Bandwidth, GB/s (STREAM kernels on doubles)\n");
+    printf("%-6s %10s %8s %9s %9s %9s %9s\n", "level", "set/thread", "threads", "copy", "scale", "add", "triad");
+    for (int l = 0; l < r.num_levels; l++) {
+        for (int t = 0; t < r.num_counts; t++) {
+            int threads = r.threads[t];
+            // three arrays filling half the level
+            long set = strcmp(r.level[l], "L3") == 0 ? r.capacity[l] / 2 / threads
+                     : r.capacity[l] ? r.capacity[l] / 2 : dram / threads;
+            if (measure_stream(bm, &opts, r.level[l], set / (3 * sizeof(double)), threads, r.bandwidth[l][t]) != 0) {
+                fprintf(stderr, "Memory allocation failed\n");
+                return 1;
+            }
+            double *bw = r.bandwidth[l][t];
+            printf("%-6s %7ld KB %8d %9.2f %9.2f %9.2f %9.2f\n", r.level[l], set / 1024, threads, bw[0], bw[1], bw[2], bw[3]);
+        }
+    }
+
+    printf("\nPeak, GFLOP/s (%d independent multiply-add chains per thread)\n", PEAK_ACCS);
+    printf("%-6s %8s %9s %9s\n", "isa", "threads", "float", "double");
+    for (int i = 0; i < (int)(sizeof(isas) / sizeof(isas[0])); i++) {
+        if (!isa_supported(i)) continue;
+        int s = r.num_isas++;
+        snprintf(r.isa[s], sizeof(r.isa[0]), "%s", isas[i].name);
+        for (int t = 0; t < r.num_counts; t++) {
+            for (int d = 0; d < 2; d++) {
+                peak_args args = { isas[i].kernel[d], r.threads[t], 0.0 };
+                char name[64];
+                snprintf(name, sizeof(name), "peak/%s/%s/%d", isas[i].name, d ? "f64" : "f32", r.threads[t]);
+                bench_stats stats;
+                if (bench_run(bm, name, run_peak, &args, &opts, &stats) != 0) { fprintf(stderr, "Memory allocation failed\n"); return 1; }
+                double flops = 2.0 * PEAK_ACCS * isas[i].lanes[d] * (double)PEAK_ITERS * r.threads[t];
+                r.peak[s][t][d] = flops / stats.min / 1e9;
+            }
+            printf("%-6s %8d %9.2f %9.2f\n", r.isa[s], r.threads[t], r.peak[s][t][0], r.peak[s][t][1]);
+        }
+    }
+    bench_destroy(bm);
+
+    if (roofline_save(&r, out) != 0) return 1;
+    printf("\nWrote %s\n", out);
+    return 0;
+}
@@ -0,0 +1,283 @@
+/* ompt_trace.c - OMPT tool that records a per-thread execution timeline
+   and writes it as Chrome / Perfetto trace JSON.
+
+   Build:  make -C common libompt_trace.so
+   Run:    OMP_TOOL_LIBRARIES=$PWD/common/libompt_trace.so ./usleep
+   View:   open ompt_trace.json in chrome://tracing or ui.perfetto.dev
+
+   Environment:
+     OMPT_TRACE_FILE    output path (default ompt_trace.json)
+     OMPT_TRACE_EVENTS  ring buffer capacity per thread (default 65536)
+
+   Needs an OpenMP runtime with OMPT support (LLVM libomp). GCC's libgomp has
+   no OMPT, so link with -lomp instead: compile with -fopenmp, then link the
+   objects without -fopenmp against libomp (it provides the GOMP_* entry points).
+
+   Each thread appends complete events (start, duration) to its own ring
+   buffer, so recording takes no locks; when a ring fills the oldest events
+   are overwritten. Buffers are only read when the runtime shuts down. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <omp-tools.h>
+
+#define DEFAULT_EVENTS 65536
+#define MAX_DEPTH 32
+
+enum trace_name {
+    EV_PARALLEL, EV_IMPLICIT_TASK, EV_LOOP, EV_SECTIONS, EV_SINGLE, EV_WORKSHARE,
+    EV_CHUNK, EV_BARRIER, EV_BARRIER_WAIT, EV_TASKWAIT, EV_TASKWAIT_WAIT,
+    EV_REDUCTION, EV_OTHER_SYNC, EV_OTHER_WAIT, NUM_NAMES
+};
+
+static const char *trace_names[NUM_NAMES] = {
+    "parallel", "implicit task", "loop", "sections", "single", "workshare",
+    "chunk", "barrier", "barrier wait", "taskwait", "taskwait wait",
+    "reduction", "sync", "sync wait",
+};
+
+typedef struct {
+    uint64_t start_ns, dur_ns;
+    uint32_t name;
+    uint64_t arg;
+} trace_event;
+
+typedef struct trace_buffer {
+    int tid;
+    uint64_t head; /* events ever written; slot is head % capacity */
+    trace_event *events;
+
+    /* begin timestamps of the scopes currently open on this thread */
+    uint64_t open_start[MAX_DEPTH];
+    uint32_t open_name[MAX_DEPTH];
+    uint64_t open_arg[MAX_DEPTH];
+    int depth;
+
+    /* the chunk being executed, closed by the next dispatch or the loop end */
+    uint64_t chunk_start, chunk_first;
+    int chunk_open;
+
+    uint64_t wait_ns; /* total barrier/taskwait wait, for the summary */
+    struct trace_buffer *next;
+} trace_buffer;
+
+static __thread trace_buffer *my_buffer;
+static trace_buffer *all_buffers;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_tid;
+static uint64_t capacity = DEFAULT_EVENTS;
+static uint64_t t_origin;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Lazily created so that events arriving before thread_begin are kept too */
+static trace_buffer *buffer(void) {
+    if (my_buffer) return my_buffer;
+    trace_buffer *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->events = malloc(sizeof(trace_event) * capacity);
+    if (!b->events) { free(b); return NULL; }
+
+    pthread_mutex_lock(&buffers_lock);
+    b->tid = next_tid++;
+    b->next = all_buffers;
+    all_buffers = b;
+    pthread_mutex_unlock(&buffers_lock);
+
+    my_buffer = b;
+    return b;
+}
+
+static void emit(trace_buffer *b, uint32_t name, uint64_t start, uint64_t end, uint64_t arg) {
+    trace_event *e = &b->events[b->head++ % capacity];
+    e->start_ns = start - t_origin;
+    e->dur_ns = end - start;
+    e->name = name;
+    e->arg = arg;
+}
+
+static void scope_begin(uint32_t name, uint64_t arg) {
+    trace_buffer *b = buffer();
+    if (!b) return;
+    if (b->depth < MAX_DEPTH) {
+        b->open_start[b->depth] = now_ns();
+        b->open_name[b->depth] = name;
+        b->open_arg[b->depth] = arg;
+    }
+    b->depth++;
+}
+
+static void scope_end(uint32_t name) {
+    trace_buffer *b = buffer();
+    if (!b || b->depth == 0) return;
+    b->depth--;
+    if (b->depth >= MAX_DEPTH || b->open_name[b->depth] != name) return;
+    uint64_t end = now_ns();
+    uint64_t start = b->open_start[b->depth];
+    if (name == EV_BARRIER_WAIT || name == EV_TASKWAIT_WAIT || name == EV_OTHER_WAIT)
+        b->wait_ns += end - start;
+    emit(b, name, start, end, b->open_arg[b->depth]);
+}
+
+static void chunk_close(trace_buffer *b, uint64_t end) {
+    if (!b->chunk_open) return;
+    emit(b, EV_CHUNK, b->chunk_start, end, b->chunk_first);
+    b->chunk_open = 0;
+}
+
+/* ---- callbacks ---- */
+
+static void on_thread_begin(ompt_thread_t type, ompt_data_t *thread_data) {
+    buffer();
+}
+
+static void on_parallel_begin(ompt_data_t *task, const ompt_frame_t *frame, ompt_data_t *parallel,
+                              unsigned int requested, int flags, const void *codeptr) {
+    scope_begin(EV_PARALLEL, requested);
+}
+
+static void on_parallel_end(ompt_data_t *parallel, ompt_data_t *task, int flags, const void *codeptr) {
+    scope_end(EV_PARALLEL);
+}
+
+static void on_implicit_task(ompt_scope_endpoint_t endpoint, ompt_data_t *parallel, ompt_data_t *task,
+                             unsigned int actual, unsigned int index, int flags) {
+    if (flags & ompt_task_initial) return;
+    if (endpoint == ompt_scope_begin) scope_begin(EV_IMPLICIT_TASK, index);
+    else scope_end(EV_IMPLICIT_TASK);
+}
+
+static uint32_t work_name(ompt_work_t type) {
+    switch (type) {
+        case ompt_work_loop: return EV_LOOP;
+        case ompt_work_sections: return EV_SECTIONS;
+        case ompt_work_single_executor:
+        case ompt_work_single_other: return EV_SINGLE;
+        default: return EV_WORKSHARE;
+    }
+}
+
+static void on_work(ompt_work_t type, ompt_scope_endpoint_t endpoint, ompt_data_t *parallel,
+                    ompt_data_t *task, uint64_t count, const void *codeptr) {
+    if (endpoint == ompt_scope_begin) {
+        scope_begin(work_name(type), count);
+    } else {
+        trace_buffer *b = buffer();
+        if (b) chunk_close(b, now_ns());
+        scope_end(work_name(type));
+    }
+}
+
+static void on_dispatch(ompt_data_t *parallel, ompt_data_t *task, ompt_dispatch_t kind, ompt_data_t instance) {
+    trace_buffer *b = buffer();
+    if (!b) return;
+    uint64_t t = now_ns();
+    chunk_close(b, t);
+    b->chunk_start = t;
+    b->chunk_first = instance.value;
+    b->chunk_open = 1;
+}
+
+static uint32_t sync_name(ompt_sync_region_t kind, int wait) {
+    switch (kind) {
+        case ompt_sync_region_barrier:
+        case ompt_sync_region_barrier_implicit:
+        case ompt_sync_region_barrier_explicit:
+        case ompt_sync_region_barrier_implementation:
+        case ompt_sync_region_barrier_implicit_workshare:
+        case ompt_sync_region_barrier_implicit_parallel:
+            return wait ? EV_BARRIER_WAIT : EV_BARRIER;
+        case ompt_sync_region_taskwait:
+        case ompt_sync_region_taskgroup:
+            return wait ? EV_TASKWAIT_WAIT : EV_TASKWAIT;
+        case ompt_sync_region_reduction:
+            return wait ? EV_OTHER_WAIT : EV_REDUCTION;
+        default:
+            return wait ? EV_OTHER_WAIT : EV_OTHER_SYNC;
+    }
+}
+
+static void on_sync_region(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint,
+                           ompt_data_t *parallel, ompt_data_t *task, const void *codeptr) {
+    if (endpoint == ompt_scope_begin) scope_begin(sync_name(kind, 0), 0);
+    else scope_end(sync_name(kind, 0));
+}
+
+static void on_sync_region_wait(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint,
+                                ompt_data_t *parallel, ompt_data_t *task, const void *codeptr) {
+    if (endpoint == ompt_scope_begin) scope_begin(sync_name(kind, 1), 0);
+    else scope_end(sync_name(kind, 1));
+}
+
+/* ---- output ---- */
+
+static void write_trace(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) { perror(path); return; }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    for (trace_buffer *b = all_buffers; b; b = b->next) {
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+                    "\"args\":{\"name\":\"OpenMP thread %d\"}}", first ? "" : ",\n", b->tid, b->tid);
+        first = 0;
+
+        uint64_t n = b->head < capacity ? b->head : capacity;
+        for (uint64_t k = b->head - n; k < b->head; k++) {
+            const trace_event *e = &b->events[k % capacity];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%llu}}",
+                    trace_names[e->name], b->tid, e->start_ns / 1e3, e->dur_ns / 1e3,
+                    (unsigned long long)e->arg);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    fprintf(stderr, "ompt_trace: wrote %s\n", path);
+    for (trace_buffer *b = all_buffers; b; b = b->next) {
+        fprintf(stderr, "ompt_trace: thread %d: %llu events", b->tid, (unsigned long long)b->head);
+        if (b->head > capacity)
+            fprintf(stderr, " (%llu oldest dropped)", (unsigned long long)(b->head - capacity));
+        fprintf(stderr, ", %.6f s waiting\n", b->wait_ns / 1e9);
+    }
+}
+
+static int tool_initialize(ompt_function_lookup_t lookup, int initial_device_num, ompt_data_t *tool_data) {
+    const char *cap = getenv("OMPT_TRACE_EVENTS");
+    if (cap && atol(cap) > 0) capacity = (uint64_t)atol(cap);
+    t_origin = now_ns();
+
+    ompt_set_callback_t set_callback = (ompt_set_callback_t)lookup("ompt_set_callback");
+    if (!set_callback) return 0;
+
+    set_callback(ompt_callback_thread_begin, (ompt_callback_t)on_thread_begin);
+    set_callback(ompt_callback_parallel_begin, (ompt_callback_t)on_parallel_begin);
+    set_callback(ompt_callback_parallel_end, (ompt_callback_t)on_parallel_end);
+    set_callback(ompt_callback_implicit_task, (ompt_callback_t)on_implicit_task);
+    set_callback(ompt_callback_work, (ompt_callback_t)on_work);
+    set_callback(ompt_callback_sync_region, (ompt_callback_t)on_sync_region);
+    set_callback(ompt_callback_sync_region_wait, (ompt_callback_t)on_sync_region_wait);
+    // chunk events need OpenMP 5.1 dispatch support; without it loops show as one block per thread
+    if (set_callback(ompt_callback_dispatch, (ompt_callback_t)on_dispatch) == ompt_set_never)
+        fprintf(stderr, "ompt_trace: runtime does not report chunk dispatch\n");
+    return 1;
+}
+
+static void tool_finalize(ompt_data_t *tool_data) {
+    const char *path = getenv("OMPT_TRACE_FILE");
+    write_trace(path ? path : "ompt_trace.json");
+}
+
+ompt_start_tool_result_t *ompt_start_tool(unsigned int omp_version, const char *runtime_version) {
+    static ompt_start_tool_result_t result = { tool_initialize, tool_finalize, { 0 } };
+    return &result;
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+
+#include "partition.h"
+
+#define CACHE_LINE 64
+
+/* One cursor per part, each on its own cache line. next only ever moves
+   forward through atomic fetch-add, whether by the owner or by a thief. */
+typedef struct {
+    long next;
+    long end;
+} __attribute__((aligned(CACHE_LINE))) steal_cursor;
+
+struct partition_steal {
+    int parts;
+    long grain;
+    steal_cursor *cursor;
+};
+
+/* Rows before i cost i*n - i*(i-1)/2 in total */
+static double triangular_prefix(long n, long i) {
+    return (double)i * n - (double)i * (i - 1) / 2.0;
+}
+
+int partition_triangular(long n, int parts, long *bounds) {
+    if (n < 0 || parts <= 0) return -1;
+    double total = triangular_prefix(n, n);
+    bounds[0] = 0;
+    for (int p = 1; p < parts; p++) {
+        // smallest row whose prefix reaches the p-th share
+        double target = total * p / parts;
+        long lo = bounds[p - 1], hi = n;
+        while (lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (triangular_prefix(n, mid) < target) lo = mid + 1;
+            else hi = mid;
+        }
+        // step back a row if that lands nearer the target
+        if (lo > bounds[p - 1] && target - triangular_prefix(n, lo - 1) < triangular_prefix(n, lo) - target)
+            lo--;
+        bounds[p] = lo;
+    }
+    bounds[parts] = n;
+    return 0;
+}
+
+int partition_weighted(const double *weight, long n, int parts, long *bounds) {
+    if (n < 0 || parts <= 0) return -1;
+    double *prefix = malloc(sizeof(double) * (n + 1));
+    if (!prefix) return -1;
+
+    prefix[0] = 0.0;
+    for (long i = 0; i < n; i++)
+        prefix[i + 1] = prefix[i] + weight[i];
+
+    bounds[0] = 0;
+    for (int p = 1; p < parts; p++) {
+        double target = prefix[n] * p / parts;
+        long lo = bounds[p - 1], hi = n;
+        while (lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (prefix[mid] < target) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo > bounds[p - 1] && target - prefix[lo - 1] < prefix[lo] - target)
+            lo--;
+        bounds[p] = lo;
+    }
+    bounds[parts] = n;
+
+    free(prefix);
+    return 0;
+}
+
+partition_steal *partition_steal_create(const long *bounds, int parts, long grain) {
+    partition_steal *s = malloc(sizeof(*s));
+    if (!s) return NULL;
+    s->cursor = aligned_alloc(CACHE_LINE, sizeof(steal_cursor) * parts);
+    if (!s->cursor) { free(s); return NULL; }
+    s->parts = parts;
+    s->grain = grain > 0 ? grain : 1;
+    for (int p = 0; p < parts; p++) {
+        s->cursor[p].next = bounds[p];
+        s->cursor[p].end = bounds[p + 1];
+    }
+    return s;
+}
+
+static int claim(steal_cursor *c, long grain, long *begin, long *end) {
+    if (__atomic_load_n(&c->next, __ATOMIC_RELAXED) >= c->end) return 0;
+    long b = __atomic_fetch_add(&c->next, grain, __ATOMIC_RELAXED);
+    if (b >= c->end) return 0;
+    *begin = b;
+    *end = (b + grain < c->end) ? b + grain : c->end;
+    return 1;
+}
+
+int partition_steal_next(partition_steal *s, int t, long *begin, long *end) {
+    // own rows first, then the other parts starting with the next one along
+    for (int k = 0; k < s->parts; k++) {
+        int victim = (t + k) % s->parts;
+        if (claim(&s->cursor[victim], s->grain, begin, end)) return 1;
+    }
+    return 0;
+}
+
+void partition_steal_destroy(partition_steal *s) {
+    if (!s) return;
+    free(s->cursor);
+    free(s);
+}
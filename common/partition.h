@@ -0,0 +1,29 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+/* Ahead-of-time equal-cost partitioning of irregular iteration spaces.
+
+   Each function fills bounds[0..parts] so that part p owns rows
+   [bounds[p], bounds[p+1]) and all parts carry (as near as whole rows allow)
+   the same total cost. Contiguous chunks keep each thread's rows together,
+   unlike schedule(static, 1), and cost nothing at run time, unlike dynamic. */
+
+/* Triangular nest for (i = 0; i < n; i++) for (j = 0; j < n - i; j++): row i costs n - i.
+   Returns 0, or -1 on bad arguments. */
+int partition_triangular(long n, int parts, long *bounds);
+
+/* Row i costs weight[i] (non-negative). Returns 0, or -1 on bad arguments or allocation failure. */
+int partition_weighted(const double *weight, long n, int parts, long *bounds);
+
+/* Work-stealing fallback for when the cost model is wrong. Each part starts
+   with its precomputed rows and claims them grain rows at a time; once its own
+   rows are gone a thread claims rows from the other parts instead. Every row
+   is handed out exactly once. */
+typedef struct partition_steal partition_steal;
+
+partition_steal *partition_steal_create(const long *bounds, int parts, long grain);
+/* Next rows for part t, returns 0 once every part is exhausted */
+int partition_steal_next(partition_steal *s, int t, long *begin, long *end);
+void partition_steal_destroy(partition_steal *s);
+
+#endif
@@ -0,0 +1,387 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "reduce.h"
+
+#define REDUCE_BLOCK 4096 // argmin/argmax rescan granularity, stays in L1
+#define REPRO_LANES 16    // fixed accumulator count for reproducible block sums
+#define EXACT_BINS 320    // float exponents 1..254 plus headroom for carries
+#define EXACT_BIAS 150    // bin e holds multiples of 2^(e - 150)
+
+enum reduce_op { OP_SUM, OP_MIN, OP_MAX, OP_ARGMIN, OP_ARGMAX, OP_HISTOGRAM };
+
+/* One per thread. The alignment pads each slot to whole cache lines so two
+   threads never write to the same line. */
+typedef struct {
+    double sum;
+    reduce_loc loc;
+    long *bins;
+} __attribute__((aligned(REDUCE_CACHE_LINE))) reduce_partial;
+
+typedef struct {
+    float lo, hi, scale;
+    int num_bins;
+} histogram_args;
+
+/* Contiguous slice [lo, hi) of n items for thread t of nth */
+static void thread_range(long n, int t, int nth, long *lo, long *hi) {
+    long base = n / nth, extra = n % nth;
+    *lo = t * base + (t < extra ? t : extra);
+    *hi = *lo + base + (t < extra);
+}
+
+static double sum_range(const float *x, long lo, long hi) {
+    double s = 0.0;
+    #pragma omp simd reduction(+:s)
+    for (long i = lo; i < hi; i++)
+        s += x[i];
+    return s;
+}
+
+static float min_range(const float *x, long lo, long hi) {
+    float m = INFINITY;
+    #pragma omp simd reduction(min:m)
+    for (long i = lo; i < hi; i++)
+        m = x[i] < m ? x[i] : m;
+    return m;
+}
+
+static float max_range(const float *x, long lo, long hi) {
+    float m = -INFINITY;
+    #pragma omp simd reduction(max:m)
+    for (long i = lo; i < hi; i++)
+        m = x[i] > m ? x[i] : m;
+    return m;
+}
+
+/* Find the block extreme with a SIMD pass, and only rescan a block for the
+   position when it improves on the best so far. */
+static reduce_loc argmin_range(const float *x, long lo, long hi) {
+    reduce_loc best = { INFINITY, -1 };
+    if (lo < hi) { best.value = x[lo]; best.index = lo; }
+    for (long b = lo; b < hi; b += REDUCE_BLOCK) {
+        long e = (hi - b < REDUCE_BLOCK) ? hi : b + REDUCE_BLOCK;
+        float m = min_range(x, b, e);
+        if (m < best.value) {
+            long i = b;
+            while (x[i] != m) i++;
+            best.value = m;
+            best.index = i;
+        }
+    }
+    return best;
+}
+
+static reduce_loc argmax_range(const float *x, long lo, long hi) {
+    reduce_loc best = { -INFINITY, -1 };
+    if (lo < hi) { best.value = x[lo]; best.index = lo; }
+    for (long b = lo; b < hi; b += REDUCE_BLOCK) {
+        long e = (hi - b < REDUCE_BLOCK) ? hi : b + REDUCE_BLOCK;
+        float m = max_range(x, b, e);
+        if (m > best.value) {
+            long i = b;
+            while (x[i] != m) i++;
+            best.value = m;
+            best.index = i;
+        }
+    }
+    return best;
+}
+
+static void histogram_range(const float *x, long lo, long hi, const histogram_args *h, long *bins) {
+    memset(bins, 0, sizeof(long) * h->num_bins);
+    for (long i = lo; i < hi; i++) {
+        float v = x[i];
+        if (!(v >= h->lo && v < h->hi)) continue; // also drops NaN
+        int b = (int)((v - h->lo) * h->scale);
+        bins[b < h->num_bins ? b : h->num_bins - 1]++;
+    }
+}
+
+/* Merge partial b into partial a. a always covers the lower indices, so ties
+   in argmin/argmax keep a and the first occurrence wins. */
+static void combine(enum reduce_op op, reduce_partial *a, const reduce_partial *b, int num_bins) {
+    switch (op) {
+        case OP_SUM:
+            a->sum += b->sum;
+            break;
+        case OP_MIN:
+            if (b->loc.value < a->loc.value) a->loc.value = b->loc.value;
+            break;
+        case OP_MAX:
+            if (b->loc.value > a->loc.value) a->loc.value = b->loc.value;
+            break;
+        case OP_ARGMIN:
+            if (b->loc.index >= 0 && (a->loc.index < 0 || b->loc.value < a->loc.value)) a->loc = b->loc;
+            break;
+        case OP_ARGMAX:
+            if (b->loc.index >= 0 && (a->loc.index < 0 || b->loc.value > a->loc.value)) a->loc = b->loc;
+            break;
+        case OP_HISTOGRAM:
+            for (int k = 0; k < num_bins; k++) a->bins[k] += b->bins[k];
+            break;
+    }
+}
+
+/* Run op over x and return the merged result in *result. For OP_HISTOGRAM the
+   caller supplies per-thread bin storage of bin_stride longs per thread. */
+static int reduce_run(enum reduce_op op, const float *x, long n, const histogram_args *h,
+                      long *bin_storage, long bin_stride, reduce_partial *result) {
+    int max_threads = omp_get_max_threads();
+    reduce_partial *part = aligned_alloc(REDUCE_CACHE_LINE, sizeof(reduce_partial) * max_threads);
+    if (!part) return -1;
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        long lo, hi;
+        thread_range(n, t, nth, &lo, &hi);
+
+        reduce_partial *mine = &part[t];
+        switch (op) {
+            case OP_SUM: mine->sum = sum_range(x, lo, hi); break;
+            case OP_MIN: mine->loc.value = min_range(x, lo, hi); break;
+            case OP_MAX: mine->loc.value = max_range(x, lo, hi); break;
+            case OP_ARGMIN: mine->loc = argmin_range(x, lo, hi); break;
+            case OP_ARGMAX: mine->loc = argmax_range(x, lo, hi); break;
+            case OP_HISTOGRAM:
+                mine->bins = &bin_storage[t * bin_stride];
+                histogram_range(x, lo, hi, h, mine->bins);
+                break;
+        }
+
+        // tree combine: at each level thread t folds in its neighbour t + stride
+        for (int stride = 1; stride < nth; stride *= 2) {
+            #pragma omp barrier
+            if (t % (2 * stride) == 0 && t + stride < nth)
+                combine(op, mine, &part[t + stride], h ? h->num_bins : 0);
+        }
+    }
+
+    *result = part[0];
+    free(part);
+    return 0;
+}
+
+double reduce_sum(const float *x, long n) {
+    reduce_partial r;
+    if (reduce_run(OP_SUM, x, n, NULL, NULL, 0, &r) != 0) return sum_range(x, 0, n);
+    return r.sum;
+}
+
+float reduce_min(const float *x, long n) {
+    reduce_partial r;
+    if (reduce_run(OP_MIN, x, n, NULL, NULL, 0, &r) != 0) return min_range(x, 0, n);
+    return r.loc.value;
+}
+
+float reduce_max(const float *x, long n) {
+    reduce_partial r;
+    if (reduce_run(OP_MAX, x, n, NULL, NULL, 0, &r) != 0) return max_range(x, 0, n);
+    return r.loc.value;
+}
+
+reduce_loc reduce_argmin(const float *x, long n) {
+    reduce_partial r;
+    if (reduce_run(OP_ARGMIN, x, n, NULL, NULL, 0, &r) != 0) return argmin_range(x, 0, n);
+    return r.loc;
+}
+
+reduce_loc reduce_argmax(const float *x, long n) {
+    reduce_partial r;
+    if (reduce_run(OP_ARGMAX, x, n, NULL, NULL, 0, &r) != 0) return argmax_range(x, 0, n);
+    return r.loc;
+}
+
+int reduce_histogram(const float *x, long n, float lo, float hi, long *bins, int num_bins) {
+    if (num_bins <= 0 || !(hi > lo)) return -1;
+
+    // round every thread's bins up to whole cache lines
+    long per_line = REDUCE_CACHE_LINE / sizeof(long);
+    long stride = (num_bins + per_line - 1) / per_line * per_line;
+    long *storage = aligned_alloc(REDUCE_CACHE_LINE, sizeof(long) * stride * omp_get_max_threads());
+    if (!storage) return -1;
+
+    histogram_args h = { lo, hi, num_bins / (hi - lo), num_bins };
+    reduce_partial r;
+    int rc = reduce_run(OP_HISTOGRAM, x, n, &h, storage, stride, &r);
+    if (rc == 0) memcpy(bins, r.bins, sizeof(long) * num_bins);
+
+    free(storage);
+    return rc;
+}
+
+/* Fixed-order block sum: lane k always sees elements k, k + 16, k + 32, ...
+   and the lanes are folded in a fixed pairwise order. Unlike an omp simd
+   reduction this does not depend on how the compiler peels for alignment. */
+static double repro_block_sum(const float *x, long len) {
+    double acc[REPRO_LANES] = {0};
+    long i = 0;
+    for (; i + REPRO_LANES <= len; i += REPRO_LANES)
+        for (int k = 0; k < REPRO_LANES; k++)
+            acc[k] += x[i + k];
+    for (int k = 0; i < len; i++, k++)
+        acc[k] += x[i];
+    for (int width = REPRO_LANES / 2; width >= 1; width /= 2)
+        for (int k = 0; k < width; k++)
+            acc[k] += acc[k + width];
+    return acc[0];
+}
+
+double reduce_sum_repro(const float *x, long n) {
+    long num_blocks = (n + REDUCE_REPRO_BLOCK - 1) / REDUCE_REPRO_BLOCK;
+    if (num_blocks <= 1) return repro_block_sum(x, n);
+
+    double *block = malloc(sizeof(double) * num_blocks);
+    if (!block) {
+        /* Serial walk of the same tree without the block array: a binary
+           counter of completed subtrees, folded right to left at the end. */
+        double stack[64];
+        long size[64];
+        int top = 0;
+        for (long b = 0; b < num_blocks; b++) {
+            long start = b * REDUCE_REPRO_BLOCK;
+            long len = (n - start < REDUCE_REPRO_BLOCK) ? n - start : REDUCE_REPRO_BLOCK;
+            stack[top] = repro_block_sum(&x[start], len);
+            size[top++] = 1;
+            while (top >= 2 && size[top - 2] == size[top - 1]) {
+                stack[top - 2] += stack[top - 1];
+                size[top - 2] *= 2;
+                top--;
+            }
+        }
+        while (top >= 2) {
+            stack[top - 2] += stack[top - 1];
+            top--;
+        }
+        return stack[0];
+    }
+
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for (long b = 0; b < num_blocks; b++) {
+            long start = b * REDUCE_REPRO_BLOCK;
+            long len = (n - start < REDUCE_REPRO_BLOCK) ? n - start : REDUCE_REPRO_BLOCK;
+            block[b] = repro_block_sum(&x[start], len);
+        }
+
+        // pairwise tree over block indices; the shape depends only on num_blocks
+        for (long width = 1; width < num_blocks; width *= 2) {
+            #pragma omp for schedule(static)
+            for (long b = 0; b < num_blocks - width; b += 2 * width)
+                block[b] += block[b + width];
+        }
+    }
+
+    double sum = block[0];
+    free(block);
+    return sum;
+}
+
+/* Add every float of [lo, hi) exactly into bins[]: a float is an integer
+   mantissa (at most 24 bits) times 2^(exponent - 150), so it is added to
+   bins[exponent] as that integer. 2^39 additions fit before int64 overflow.
+   Infinities and NaN go to *special so they still propagate. */
+static void exact_range(const float *x, long lo, long hi, int64_t *bins, double *special) {
+    for (long i = lo; i < hi; i++) {
+        uint32_t bits;
+        memcpy(&bits, &x[i], sizeof(bits));
+        int e = (bits >> 23) & 0xff;
+        int64_t m = bits & 0x7fffff;
+        if (e == 0xff) { *special += x[i]; continue; }
+        if (e == 0) e = 1; // subnormal: same scale as the smallest normal
+        else m |= 1 << 23;
+        bins[e] += (bits >> 31) ? -m : m;
+    }
+}
+
+/* Normalise the bins by carrying upwards so that every bin but the last is
+   0 or 1, which writes the exact sum as a signed binary number, then round
+   that number to the nearest double, ties to even. The bins are exact, so
+   this is the only rounding: the result is correctly rounded and order-free. */
+static double exact_round(int64_t *bins) {
+    const int top = EXACT_BINS - 1;
+    for (int e = 0; e < top; e++) {
+        int64_t carry = bins[e] >> 1; // arithmetic shift: floor division
+        bins[e] -= carry * 2;
+        bins[e + 1] += carry;
+    }
+
+    // magnitude: -(t 2^top + B) = (-t - 1) 2^top + (~B + 1) over the low bits
+    int negative = bins[top] < 0;
+    if (negative) {
+        int64_t carry = 1;
+        for (int e = 0; e < top; e++) {
+            int64_t d = 1 - bins[e] + carry;
+            bins[e] = d & 1;
+            carry = d >> 1;
+        }
+        bins[top] = -bins[top] - 1 + carry;
+    }
+
+    // one bit per bin, the top bin spread over 64 more
+    unsigned char bit[EXACT_BINS - 1 + 64];
+    for (int e = 0; e < top; e++) bit[e] = (unsigned char)bins[e];
+    for (int k = 0; k < 64; k++) bit[top + k] = ((uint64_t)bins[top] >> k) & 1;
+
+    int msb = (int)sizeof(bit) - 1;
+    while (msb >= 0 && !bit[msb]) msb--;
+    if (msb < 0) return 0.0;
+
+    // the 53 bits from msb down, then round on the guard bit and the sticky rest
+    int low = msb - 52 > 0 ? msb - 52 : 0;
+    uint64_t mant = 0;
+    for (int e = msb; e >= low; e--) mant = mant << 1 | bit[e];
+    if (low > 0 && bit[low - 1]) {
+        int sticky = 0;
+        for (int e = 0; e < low - 1 && !sticky; e++) sticky = bit[e];
+        if (sticky || (mant & 1)) mant++;
+    }
+    double sum = ldexp((double)mant, low - EXACT_BIAS);
+    return negative ? -sum : sum;
+}
+
+double reduce_sum_exact(const float *x, long n) {
+    int max_threads = omp_get_max_threads();
+    int64_t *bins = aligned_alloc(REDUCE_CACHE_LINE, sizeof(int64_t) * EXACT_BINS * max_threads);
+    double *special = aligned_alloc(REDUCE_CACHE_LINE, REDUCE_CACHE_LINE * max_threads);
+    if (!bins || !special) {
+        free(bins); free(special);
+        int64_t local[EXACT_BINS] = {0};
+        double s = 0.0;
+        exact_range(x, 0, n, local, &s);
+        return exact_round(local) + s;
+    }
+    memset(bins, 0, sizeof(int64_t) * EXACT_BINS * max_threads);
+
+    int stride = REDUCE_CACHE_LINE / sizeof(double);
+    int nth_used = 1;
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        long lo, hi;
+        thread_range(n, t, nth, &lo, &hi);
+        special[t * stride] = 0.0;
+        exact_range(x, lo, hi, &bins[t * EXACT_BINS], &special[t * stride]);
+        #pragma omp single
+        nth_used = nth;
+    }
+
+    for (int t = 1; t < nth_used; t++)
+        for (int e = 0; e < EXACT_BINS; e++)
+            bins[e] += bins[t * EXACT_BINS + e];
+    double s = 0.0;
+    for (int t = 0; t < nth_used; t++)
+        s += special[t * stride];
+
+    double sum = exact_round(bins) + s;
+    free(bins);
+    free(special);
+    return sum;
+}
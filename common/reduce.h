@@ -0,0 +1,43 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+/* Contention-free parallel reductions over float arrays.
+
+   Every thread reduces a contiguous slice with a SIMD inner loop into its own
+   cache-line-padded partial, then the partials are merged pairwise in a
+   log2(threads) tree. No critical sections, no atomics, no false sharing.
+   Call these from serial code; they open their own parallel region. */
+
+#define REDUCE_CACHE_LINE 64
+#define REDUCE_REPRO_BLOCK 8192 /* floats per fixed block in reduce_sum_repro */
+
+typedef struct {
+    float value;
+    long index; /* first position holding value, -1 for an empty array */
+} reduce_loc;
+
+double reduce_sum(const float *x, long n);
+float reduce_min(const float *x, long n);
+float reduce_max(const float *x, long n);
+reduce_loc reduce_argmin(const float *x, long n);
+reduce_loc reduce_argmax(const float *x, long n);
+
+/* Reproducible sums: the same bits for any thread count and schedule.
+
+   reduce_sum_repro splits x into fixed REDUCE_REPRO_BLOCK blocks, sums each
+   block in a fixed SIMD order and combines the block sums in a fixed pairwise
+   tree over block indices, so only the block-to-thread mapping varies.
+
+   reduce_sum_exact accumulates every float exactly into integer bins, one per
+   binary exponent. Integer addition is associative, so the result does not
+   depend on order at all; it is correctly rounded to double once at the end. Slower,
+   but also independent of the block size and of the compiler's SIMD choices. */
+double reduce_sum_repro(const float *x, long n);
+double reduce_sum_exact(const float *x, long n);
+
+/* Count x into num_bins equal-width bins over [lo, hi). Values outside the
+   range are ignored. bins is overwritten. Returns 0, or -1 on bad arguments
+   or allocation failure. */
+int reduce_histogram(const float *x, long n, float lo, float hi, long *bins, int num_bins);
+
+#endif
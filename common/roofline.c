@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "roofline.h"
+
+const char *stream_names[] = { "copy", "scale", "add", "triad" };
+const int stream_bytes[] = { 16, 16, 24, 24 };
+
+const char *roofline_path(void) {
+    const char *path = getenv("MACHINE_PROBE");
+    return (path && *path) ? path : "../common/machine_probe.txt";
+}
+
+static int find_level(roofline *r, const char *name) {
+    for (int i = 0; i < r->num_levels; i++)
+        if (strcmp(r->level[i], name) == 0) return i;
+    return -1;
+}
+
+static int find_isa(roofline *r, const char *name) {
+    for (int i = 0; i < r->num_isas; i++)
+        if (strcmp(r->isa[i], name) == 0) return i;
+    if (r->num_isas == ROOFLINE_MAX_ISAS) return -1;
+    snprintf(r->isa[r->num_isas], sizeof(r->isa[0]), "%s", name);
+    return r->num_isas++;
+}
+
+// index of a thread count, added in ascending order if new
+static int find_count(roofline *r, int threads) {
+    int i = 0;
+    while (i < r->num_counts && r->threads[i] < threads) i++;
+    if (i < r->num_counts && r->threads[i] == threads) return i;
+    if (r->num_counts == ROOFLINE_MAX_COUNTS || threads < 1) return -1;
+    for (int j = r->num_counts; j > i; j--) {
+        r->threads[j] = r->threads[j - 1];
+        for (int l = 0; l < ROOFLINE_MAX_LEVELS; l++)
+            memcpy(r->bandwidth[l][j], r->bandwidth[l][j - 1], sizeof(r->bandwidth[l][j]));
+        for (int s = 0; s < ROOFLINE_MAX_ISAS; s++)
+            memcpy(r->peak[s][j], r->peak[s][j - 1], sizeof(r->peak[s][j]));
+    }
+    r->threads[i] = threads;
+    for (int l = 0; l < ROOFLINE_MAX_LEVELS; l++) memset(r->bandwidth[l][i], 0, sizeof(r->bandwidth[l][i]));
+    for (int s = 0; s < ROOFLINE_MAX_ISAS; s++) memset(r->peak[s][i], 0, sizeof(r->peak[s][i]));
+    r->num_counts++;
+    return i;
+}
+
+roofline *roofline_open(const char *path) {
+    if (!path) path = roofline_path();
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Roofline: no machine probe at %s (run \"make probe\" in common/)\n", path);
+        return NULL;
+    }
+    roofline *r = calloc(1, sizeof(*r));
+    if (!r) { fclose(fp); return NULL; }
+
+    char line[256], name[8];
+    int ok = 1, threads;
+    double v[STREAM_KERNELS];
+    size_t bytes;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "level %7s %zu", name, &bytes) == 2) {
+            ok = r->num_levels < ROOFLINE_MAX_LEVELS && find_level(r, name) < 0;
+            if (ok) {
+                snprintf(r->level[r->num_levels], sizeof(r->level[0]), "%s", name);
+                r->capacity[r->num_levels++] = bytes;
+            }
+        } else if (sscanf(line, "bw %7s %d %lf %lf %lf %lf", name, &threads, &v[0], &v[1], &v[2], &v[3]) == 6) {
+            int l = find_level(r, name), t = find_count(r, threads);
+            ok = l >= 0 && t >= 0;
+            if (ok) memcpy(r->bandwidth[l][t], v, sizeof(v));
+        } else if (sscanf(line, "peak %7s %d %lf %lf", name, &threads, &v[0], &v[1]) == 4) {
+            int s = find_isa(r, name), t = find_count(r, threads);
+            ok = s >= 0 && t >= 0;
+            if (ok) { r->peak[s][t][0] = v[0]; r->peak[s][t][1] = v[1]; }
+        } else {
+            ok = 0;
+        }
+    }
+    fclose(fp);
+    if (!ok || !r->num_levels || !r->num_counts || !r->num_isas) {
+        fprintf(stderr, "Roofline: %s is not a machine probe file\n", path);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void roofline_close(roofline *r) {
+    free(r);
+}
+
+int roofline_save(const roofline *r, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) { perror(path); return -1; }
+    fprintf(fp, "# machine_probe ceilings, read by roofline_open\n");
+    fprintf(fp, "# level NAME BYTES (per core for L1 and L2, 0 for DRAM)\n");
+    fprintf(fp, "# bw LEVEL THREADS copy scale add triad (GB/s)\n");
+    fprintf(fp, "# peak ISA THREADS float double (GFLOP/s)\n");
+    for (int l = 0; l < r->num_levels; l++)
+        fprintf(fp, "level %s %zu\n", r->level[l], r->capacity[l]);
+    for (int l = 0; l < r->num_levels; l++)
+        for (int t = 0; t < r->num_counts; t++)
+            fprintf(fp, "bw %s %d %.2f %.2f %.2f %.2f\n", r->level[l], r->threads[t],
+                    r->bandwidth[l][t][0], r->bandwidth[l][t][1], r->bandwidth[l][t][2], r->bandwidth[l][t][3]);
+    for (int s = 0; s < r->num_isas; s++)
+        for (int t = 0; t < r->num_counts; t++)
+            fprintf(fp, "peak %s %d %.2f %.2f\n", r->isa[s], r->threads[t], r->peak[s][t][0], r->peak[s][t][1]);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+double roofline_bound(const roofline *r, const roofline_work *w, char *limit, size_t limit_size) {
+    // the largest probed thread count not above the one used
+    int t = 0;
+    while (t + 1 < r->num_counts && r->threads[t + 1] <= w->threads) t++;
+
+    // the first level the working set fits in; private caches add up per thread
+    int l = r->num_levels - 1;
+    for (int i = 0; i < r->num_levels; i++) {
+        size_t capacity = r->capacity[i];
+        if (strcmp(r->level[i], "L1") == 0 || strcmp(r->level[i], "L2") == 0)
+            capacity *= w->threads > 0 ? w->threads : 1;
+        if (capacity && w->working_set <= capacity) { l = i; break; }
+    }
+
+    int s = 0;
+    for (int i = 1; i < r->num_isas; i++)
+        if (r->peak[i][t][w->is_double] > r->peak[s][t][w->is_double]) s = i;
+
+    // the fastest STREAM kernel, at this level or any below it: reads alone
+    // run faster than triad, and a level cannot be slower than the next one
+    int bl = l, bk = STREAM_TRIAD;
+    for (int i = l; i < r->num_levels; i++)
+        for (int k = 0; k < STREAM_KERNELS; k++)
+            if (r->bandwidth[i][t][k] > r->bandwidth[bl][t][bk]) { bl = i; bk = k; }
+    double bandwidth = r->bandwidth[bl][t][bk];
+    double peak = r->peak[s][t][w->is_double];
+    double memory = w->bytes > 0 ? w->flops / w->bytes * bandwidth : peak;
+    const char *plural = r->threads[t] == 1 ? "" : "s";
+    if (memory < peak) {
+        if (limit) snprintf(limit, limit_size, "%s, %s %.1f GB/s, %d thread%s", r->level[bl], stream_names[bk], bandwidth, r->threads[t], plural);
+        return memory;
+    }
+    if (limit) snprintf(limit, limit_size, "%s %s peak %.1f GFLOP/s, %d thread%s", r->isa[s],
+                        w->is_double ? "double" : "float", peak, r->threads[t], plural);
+    return peak;
+}
+
+void roofline_print(FILE *fp, const roofline *r, const char *name, const roofline_work *w, double seconds) {
+    if (!r || seconds <= 0) return;
+    char limit[96];
+    double bound = roofline_bound(r, w, limit, sizeof(limit));
+    double achieved = w->flops / seconds / 1e9;
+    fprintf(fp, "Roofline %s: %.3g flop/B, %.2f GFLOP/s of %.2f (%s) = %.0f%%\n",
+            name, w->bytes > 0 ? w->flops / w->bytes : 0.0, achieved, bound, limit,
+            bound > 0 ? 100.0 * achieved / bound : 0.0);
+}
+
+void roofline_print_sum(FILE *fp, const roofline *r, const char *name, size_t n, int threads, double seconds) {
+    roofline_work w = { (double)n, (double)n * sizeof(float), n * sizeof(float), threads, 1 };
+    roofline_print(fp, r, name, &w, seconds);
+}
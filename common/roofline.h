@@ -0,0 +1,79 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Roofline bounds from the ceilings machine_probe measured on this machine.
+
+   machine_probe (see common/Makefile) times the STREAM copy, scale, add and
+   triad kernels on working sets that fit in each cache level and on one that
+   only fits in DRAM, at 1, 2, 4 ... threads, and the peak float and double
+   FMA throughput of each ISA the CPU runs. It writes them to a probe file,
+   $MACHINE_PROBE or ../common/machine_probe.txt by default, which is where
+   the labs and assignment1 find it.
+
+   A benchmark describes one call of its kernel as a roofline_work and gets
+     bound = min(peak, flops / bytes * bandwidth)
+   where bandwidth is the fastest STREAM rate of the level the working set
+   fits in (L1 and L2 counted per thread, the rest shared) and peak that of
+   the fastest ISA, both at the thread count used. roofline_print reports
+   the achieved rate as a fraction of that bound. */
+
+#define ROOFLINE_MAX_LEVELS 4   /* L1, L2, L3, DRAM */
+#define ROOFLINE_MAX_COUNTS 16  /* thread counts */
+#define ROOFLINE_MAX_ISAS 4     /* scalar, sse2, avx2, avx512 */
+
+typedef enum { STREAM_COPY, STREAM_SCALE, STREAM_ADD, STREAM_TRIAD } stream_kernel;
+#define STREAM_KERNELS 4
+extern const char *stream_names[]; /* "copy", "scale", "add", "triad" */
+
+/* STREAM counts 16 bytes per element for copy and scale, 24 for add and
+   triad, and no write-allocate traffic */
+extern const int stream_bytes[];
+
+typedef struct {
+    int num_levels;
+    char level[ROOFLINE_MAX_LEVELS][8];
+    size_t capacity[ROOFLINE_MAX_LEVELS];   /* bytes; per core for L1 and L2, 0 for DRAM */
+    int num_counts;
+    int threads[ROOFLINE_MAX_COUNTS];       /* ascending */
+    double bandwidth[ROOFLINE_MAX_LEVELS][ROOFLINE_MAX_COUNTS][STREAM_KERNELS]; /* GB/s */
+    int num_isas;
+    char isa[ROOFLINE_MAX_ISAS][8];
+    double peak[ROOFLINE_MAX_ISAS][ROOFLINE_MAX_COUNTS][2];  /* GFLOP/s, [0] float, [1] double */
+} roofline;
+
+/* One call of a benchmarked kernel */
+typedef struct {
+    double flops;          /* floating-point operations, an FMA counting two */
+    double bytes;          /* compulsory traffic: inputs read and outputs written once */
+    size_t working_set;    /* bytes touched, which picks the bandwidth level */
+    int threads;
+    int is_double;         /* arithmetic in double rather than float */
+} roofline_work;
+
+/* Default probe file: $MACHINE_PROBE, or ../common/machine_probe.txt */
+const char *roofline_path(void);
+
+/* Read a probe file (path NULL for the default). Returns NULL if there is
+   none or it cannot be parsed, after telling stderr how to make one. */
+roofline *roofline_open(const char *path);
+void roofline_close(roofline *r);
+
+/* Write the ceilings as a probe file. Returns 0, or -1 on I/O errors. */
+int roofline_save(const roofline *r, const char *path);
+
+/* Attainable GFLOP/s for w, and the ceiling that sets it ("L2, copy 96.1
+   GB/s, 4 threads" or "avx512 double peak 70.0 GFLOP/s, 4 threads") in
+   limit, which may be NULL */
+double roofline_bound(const roofline *r, const roofline_work *w, char *limit, size_t limit_size);
+
+/* "Roofline NAME: 0.25 flop/B, 3.10 GFLOP/s of 9.60 (DRAM, triad ...) = 32%".
+   Prints nothing when r is NULL, so callers need not check roofline_open. */
+void roofline_print(FILE *fp, const roofline *r, const char *name, const roofline_work *w, double seconds);
+
+/* roofline_print for a sum of n floats read once, one double add each */
+void roofline_print_sum(FILE *fp, const roofline *r, const char *name, size_t n, int threads, double seconds);
+
+#endif
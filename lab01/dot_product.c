@@ -1,12 +1,21 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
+#include <math.h>
+#include <unistd.h> // for sysconf() cache sizes
+#include <omp.h>
+
+#include "../common/bench.h"
+#include "../common/roofline.h"
 
 // #define SIZES [1, 256, 65536, 262144, 134217728]
 #define FLOAT_MIN 0
 #define FLOAT_MAX 10
 #define SEED 5507
 
+#define DOT_ACCS 64           // independent float accumulators (4 zmm / 8 ymm / 16 xmm registers)
+#define DOT_BLOCK 4096        // floats per block: each accumulator sees at most 64 terms
+#define DOT_PAR_MIN (1 << 18) // below this the OpenMP fork/join costs more than the loop
+
 const int SIZES[] = {1, 256, 65536, 262144, 16777216, 67108864}; // no. of float32s, or 4B, 1KB, 256KB, 1MB, 64MB, 256MB
 const int NUM_SIZES = sizeof(SIZES) / sizeof(SIZES[0]);
 
@@ -23,12 +32,131 @@ float dot_product(float *a, float *b, int n) {
     return sum;
 }
 
+// Exact products accumulated in double, used to judge the float results
+double dot_product_reference(const float *a, const float *b, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+        sum += (double)a[i] * b[i];
+    return sum;
+}
+
+// Sum one block with DOT_ACCS independent accumulators. The inner k loop has no
+// loop-carried dependency so it vectorises, and the 64 chains hide the add latency.
+static double dot_block(const float *a, const float *b, int len) {
+    if (len < DOT_ACCS)
+        return dot_product_reference(a, b, len);
+
+    float acc[DOT_ACCS] = {0};
+    int i = 0;
+    for (; i + DOT_ACCS <= len; i += DOT_ACCS)
+        for (int k = 0; k < DOT_ACCS; k++)
+            acc[k] += a[i + k] * b[i + k];
+    for (int k = 0; i < len; i++, k++)
+        acc[k] += a[i] * b[i];
+
+    // pairwise combine of the accumulators, finished in double
+    for (int width = DOT_ACCS / 2; width >= 8; width /= 2)
+        for (int k = 0; k < width; k++)
+            acc[k] += acc[k + width];
+    double sum = 0.0;
+    for (int k = 0; k < 8; k++)
+        sum += acc[k];
+    return sum;
+}
+
+// Neumaier-compensated accumulation of x into sum, error term kept in comp
+static inline void compensated_add(double *sum, double *comp, double x) {
+    double t = *sum + x;
+    if (fabs(*sum) >= fabs(x)) *comp += (*sum - t) + x;
+    else *comp += (x - t) + *sum;
+    *sum = t;
+}
+
+// High-throughput, accurate dot product: blocks are summed with SIMD accumulators,
+// block sums are combined with Neumaier compensation in double, and large inputs
+// are split into blocks across OpenMP threads.
+double dot_product_fast(const float *a, const float *b, int n) {
+    if (n <= DOT_BLOCK)
+        return dot_block(a, b, n);
+
+    int num_blocks = (n + DOT_BLOCK - 1) / DOT_BLOCK;
+    double sum = 0.0, comp = 0.0;
+
+    if (n < DOT_PAR_MIN) {
+        for (int blk = 0; blk < num_blocks; blk++) {
+            int start = blk * DOT_BLOCK;
+            int len = (n - start < DOT_BLOCK) ? n - start : DOT_BLOCK;
+            compensated_add(&sum, &comp, dot_block(&a[start], &b[start], len));
+        }
+        return sum + comp;
+    }
+
+    // each thread keeps its own (sum, comp) pair; the pairs are merged with
+    // compensation too, so no error term is dropped where the threads meet
+    int max_threads = omp_get_max_threads();
+    double *partial = calloc(2 * (size_t)max_threads, sizeof(double));
+    if (!partial) return NAN;
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        double t_sum = 0.0, t_comp = 0.0;
+        #pragma omp for schedule(static)
+        for (int blk = 0; blk < num_blocks; blk++) {
+            int start = blk * DOT_BLOCK;
+            int len = (n - start < DOT_BLOCK) ? n - start : DOT_BLOCK;
+            compensated_add(&t_sum, &t_comp, dot_block(&a[start], &b[start], len));
+        }
+        partial[2 * omp_get_thread_num()] = t_sum;
+        partial[2 * omp_get_thread_num() + 1] = t_comp;
+    }
+    for (int t = 0; t < max_threads; t++) {
+        compensated_add(&sum, &comp, partial[2 * t]);
+        comp += partial[2 * t + 1];
+    }
+    free(partial);
+    return sum + comp;
+}
+
+// Which level of the memory hierarchy the two input arrays fit in
+const char *memory_regime(size_t bytes) {
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l1 <= 0) l1 = 32 * 1024;
+    if (l2 <= 0) l2 = 1024 * 1024;
+    if (llc <= 0) llc = 32 * 1024 * 1024;
+
+    if (bytes <= (size_t)l1) return "L1";
+    if (bytes <= (size_t)l2) return "L2";
+    if (bytes <= (size_t)llc) return "LLC";
+    return "DRAM";
+}
+
+typedef struct {
+    float *a, *b;
+    int n;
+    double result;
+} dot_args;
+
+void run_dot_product(void *p) {
+    dot_args *d = p;
+    d->result = dot_product(d->a, d->b, d->n);
+}
+
+void run_dot_product_fast(void *p) {
+    dot_args *d = p;
+    d->result = dot_product_fast(d->a, d->b, d->n);
+}
+
 int main(int argc, char **argv) {
     printf("Using seed: %d\n", SEED);
     srand(SEED); // set the seed
 
     printf("Floats are random between %d and %d\n", FLOAT_MIN, FLOAT_MAX);
 
+    bench *bm = bench_create("dot_product");
+    roofline *roof = roofline_open(NULL);
+
     for (int i = 0; i < NUM_SIZES; i++) {
         printf("\nSize of array: %d\n", SIZES[i]);
 
@@ -41,31 +169,44 @@ int main(int argc, char **argv) {
             b[j] = float_rand(FLOAT_MIN, FLOAT_MAX);
         }
 
-        // Start wall time clock
-        struct timespec wall_start, wall_end;
-        clock_gettime(CLOCK_MONOTONIC, &wall_start);
-
-        // Start CPU time clock
-        clock_t cpu_start = clock();
+        size_t bytes = 2 * (size_t)SIZES[i] * sizeof(float);
+        printf("Working set: %zu bytes (%s)\n", bytes, memory_regime(bytes));
 
-        // Calculate dot product
-        float result = dot_product(a, b, SIZES[i]);
+        // Calculate dot product (the bench library repeats it until the timing is stable)
+        char name[64];
+        bench_stats naive, fast;
+        dot_args args = { a, b, SIZES[i], 0.0 };
+        snprintf(name, sizeof(name), "naive/%d", SIZES[i]);
+        bench_run(bm, name, run_dot_product, &args, NULL, &naive);
+        float result = args.result;
 
-        // Calculate wall time
-        clock_gettime(CLOCK_MONOTONIC, &wall_end);
-        double wall_elapsed = (wall_end.tv_sec - wall_start.tv_sec) +
-                        (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+        snprintf(name, sizeof(name), "fast/%d", SIZES[i]);
+        bench_run(bm, name, run_dot_product_fast, &args, NULL, &fast);
+        double fast_result = args.result;
 
-        // Calculate CPU time
-        clock_t cpu_end = clock();
-        double cpu_elapsed = (double)(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+        double reference = dot_product_reference(a, b, SIZES[i]);
 
         printf("Dot product result: %.0f\n", result);
-        printf("Wall time elapsed: %f seconds\n", wall_elapsed);
-        printf("CPU time elapsed: %f seconds\n", cpu_elapsed);
+        printf("Wall time elapsed: %f seconds\n", naive.median);
+        printf("CPU time elapsed: %f seconds\n", naive.cpu);
+        printf("Naive: %.3e s/call (+/- %.1e), %.2f GB/s, relative error %.2e\n",
+               naive.median, naive.stddev, bytes / naive.median / 1e9,
+               fabs(result - reference) / reference);
+        printf("Fast:  %.3e s/call (+/- %.1e), %.2f GB/s, relative error %.2e, result %.0f\n",
+               fast.median, fast.stddev, bytes / fast.median / 1e9,
+               fabs(fast_result - reference) / reference, fast_result);
+
+        // one multiply and one add per pair of floats read
+        roofline_work work = { 2.0 * SIZES[i], bytes, bytes, 1, 0 };
+        roofline_print(stdout, roof, "naive", &work, naive.median);
+        work.threads = SIZES[i] >= DOT_PAR_MIN ? omp_get_max_threads() : 1;
+        roofline_print(stdout, roof, "fast", &work, fast.median);
 
         free(a);
         free(b);
     }
+
+    bench_destroy(bm);
+    roofline_close(roof);
     return 0;
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
 #include <immintrin.h>
 
+#include "../common/bench.h"
+#include "../common/roofline.h"
+
 #define SIZE 65536
 
 float dot_avx512(float *a, float *b, int n) {
@@ -20,6 +22,16 @@ float dot_avx512(float *a, float *b, int n) {
     return sum;
 }
 
+typedef struct {
+    float *a, *b;
+    float result;
+} dot_args;
+
+void run_dot_avx512(void *p) {
+    dot_args *d = p;
+    d->result = dot_avx512(d->a, d->b, SIZE);
+}
+
 int main(int argc, char **argv) {
     float *a = (float *)malloc(SIZE * sizeof(float));
     float *b = (float *)malloc(SIZE * sizeof(float));
@@ -29,17 +41,21 @@ int main(int argc, char **argv) {
         b[i] = 2.0;
     }
 
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-
-    float result = dot_avx512(a, b, SIZE);
-
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    double elapsed = (end.tv_sec - start.tv_sec) +
-                     (end.tv_nsec - start.tv_nsec) / 1e9;
-
-    printf("Result: %.0f\n", result);
-    printf("Wall time: %f seconds\n", elapsed);
+    bench *bm = bench_create("dot_product_intrinsics");
+    dot_args args = { a, b, 0.0f };
+    bench_stats stats;
+    bench_run(bm, "avx512", run_dot_avx512, &args, NULL, &stats);
+
+    printf("Result: %.0f\n", args.result);
+    printf("Wall time: %f seconds\n", stats.median);
+    printf("CPU time: %f seconds\n", stats.cpu);
+    bench_destroy(bm);
+
+    // one thread, two floats read per multiply-add
+    roofline *roof = roofline_open(NULL);
+    roofline_work work = { 2.0 * SIZE, 8.0 * SIZE, 8 * SIZE, 1, 0 };
+    roofline_print(stdout, roof, "avx512", &work, stats.median);
+    roofline_close(roof);
 
     free(a);
     free(b);
@@ -1,22 +1,10 @@
 #include <stdio.h>
-#include <time.h>
+#include <math.h>
+#include <float.h>
 #include <omp.h>
 
-struct timespec wall_start, wall_end;
-clock_t cpu_start, cpu_end;
-
-void start_clocks(void) {
-    clock_gettime(CLOCK_MONOTONIC, &wall_start);
-    cpu_start = clock();
-}
-
-void stop_clocks(double *wall_elapsed, double *cpu_elapsed) {
-    clock_gettime(CLOCK_MONOTONIC, &wall_end);
-    *wall_elapsed = (wall_end.tv_sec - wall_start.tv_sec) +
-                   (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
-    cpu_end = clock();
-    *cpu_elapsed = (double)(cpu_end - cpu_start) / CLOCKS_PER_SEC;
-}
+#include "../common/bench.h"
+#include "../common/integrate.h"
 
 double default_pi_calculation(int num_steps) {
     double step = 1.0 / (double) num_steps;
@@ -51,46 +39,137 @@ double parallel_pi_calculation(int num_steps) {
     return pi;
 }
 
+// Batched integrands for integrate_adaptive: one call per 15-point Kronrod rule
+void pi_integrand(const double *x, double *y, int n, void *ctx) {
+    #pragma omp simd
+    for (int k = 0; k < n; k++)
+        y[k] = 4.0 / (1.0 + x[k]*x[k]);
+}
+
+// Narrow Lorentzian peak at x = 0.3: flat almost everywhere, steep near the peak
+void peak_integrand(const double *x, double *y, int n, void *ctx) {
+    double width = *(double *)ctx;
+    #pragma omp simd
+    for (int k = 0; k < n; k++) {
+        double d = x[k] - 0.3;
+        y[k] = width / (d*d + width*width);
+    }
+}
+
+// Same integrand at fixed midpoint steps, to show what uniform sampling costs
+double parallel_peak_calculation(int num_steps, double width) {
+    double step = 1.0 / (double) num_steps;
+    double sum = 0;
+
+    #pragma omp parallel for reduction(+:sum)
+    for (int i = 0; i < num_steps; i++) {
+        double d = (i+0.5) * step - 0.3;
+        sum += width / (d*d + width*width);
+    }
+
+    return step * sum;
+}
+
+// bench_run wrappers: each call stores its result in the argument struct
+typedef struct {
+    double (*calculation)(int);
+    int num_steps;
+    double pi;
+} pi_args;
+
+void run_pi(void *p) {
+    pi_args *a = p;
+    a->pi = a->calculation(a->num_steps);
+}
+
+typedef struct {
+    int num_steps;
+    double width, value;
+} peak_args;
+
+void run_peak(void *p) {
+    peak_args *a = p;
+    a->value = parallel_peak_calculation(a->num_steps, a->width);
+}
+
+typedef struct {
+    integrand_batch f;
+    void *ctx;
+    integrate_opts opts;
+    integrate_result result;
+} adaptive_args;
+
+void run_adaptive(void *p) {
+    adaptive_args *a = p;
+    a->result = integrate_adaptive(a->f, a->ctx, 0.0, 1.0, &a->opts);
+}
+
+double timed_pi(bench *bm, const char *title, double (*calculation)(int), int num_steps, double *wall_elapsed) {
+    pi_args args = { calculation, num_steps, 0.0 };
+    bench_stats stats;
+    bench_run(bm, title, run_pi, &args, NULL, &stats);
+    printf("-------- %s ----------\n", title);
+    printf("pi=%.30f\n", args.pi);
+    printf("Wall time elapsed: %f seconds\n", stats.median);
+    printf("CPU time elapsed: %f seconds\n\n", stats.cpu);
+    *wall_elapsed = stats.median;
+    return args.pi;
+}
+
+void report_adaptive(const char *title, integrate_result r, double exact, double wall_elapsed, double fixed_elapsed) {
+    printf("-------- %s ----------\n", title);
+    printf("value=%.30f\n", r.value);
+    printf("Error: %.3e (estimate %.3e)\n", fabs(r.value - exact), r.error);
+    printf("Evaluations: %ld in %ld intervals, %.3e evaluations/s\n",
+           r.evaluations, r.intervals, r.evaluations / wall_elapsed);
+    printf("Wall time elapsed: %f seconds\n", wall_elapsed);
+    printf("Speedup vs fixed-step: %.2fx\n\n", fixed_elapsed / wall_elapsed);
+}
+
 int main(int argc, char **argv) {
-    double wall_elapsed, cpu_elapsed;
+    bench *bm = bench_create("num_integration");
+    double wall_elapsed, fixed_elapsed;
 
     // No parallelisation
-    start_clocks();
-    double default_pi = default_pi_calculation(100000);
-    stop_clocks(&wall_elapsed, &cpu_elapsed);
-    printf("-------- NO PARALLELISATION, 100000 STEPS ------------------\n");
-    printf("pi=%.30f\n", default_pi);
-    printf("Wall time elapsed: %f seconds\n", wall_elapsed);
-    printf("CPU time elapsed: %f seconds\n\n", cpu_elapsed);
+    timed_pi(bm, "NO PARALLELISATION, 100000 STEPS", default_pi_calculation, 100000, &wall_elapsed);
 
     // Parallelisation (4 threads)
     omp_set_num_threads(4); // always use 4 threads
-    start_clocks();
-    double parallel_pi_1 = parallel_pi_calculation(100000);
-    stop_clocks(&wall_elapsed, &cpu_elapsed);
-    printf("-------- PARALLELISATION, 100000 STEPS, 4 THREADS ----------\n");
-    printf("pi=%.30f\n", parallel_pi_1);
-    printf("Wall time elapsed: %f seconds\n", wall_elapsed);
-    printf("CPU time elapsed: %f seconds\n\n", cpu_elapsed);
+    timed_pi(bm, "PARALLELISATION, 100000 STEPS, 4 THREADS", parallel_pi_calculation, 100000, &wall_elapsed);
 
     // Parallelisation with increased number of steps
-    start_clocks();
-    double parallel_pi_2 = parallel_pi_calculation(10000000);
-    stop_clocks(&wall_elapsed, &cpu_elapsed);
-    printf("-------- PARALLELISATION, 10000000 STEPS, 4 THREADS ----------\n");
-    printf("pi=%.30f\n", parallel_pi_2);
-    printf("Wall time elapsed: %f seconds\n", wall_elapsed);
-    printf("CPU time elapsed: %f seconds\n\n", cpu_elapsed);
+    timed_pi(bm, "PARALLELISATION, 10000000 STEPS, 4 THREADS", parallel_pi_calculation, 10000000, &wall_elapsed);
 
     // Parallelisation with increased number of threads (8 threads)
     omp_set_num_threads(8); // always use 8 threads
-    start_clocks();
-    double parallel_pi_3 = parallel_pi_calculation(10000000);
-    stop_clocks(&wall_elapsed, &cpu_elapsed);
-    printf("-------- PARALLELISATION, 10000000 STEPS, 8 THREADS ----------\n");
-    printf("pi=%.30f\n", parallel_pi_3);
-    printf("Wall time elapsed: %f seconds\n", wall_elapsed);
-    printf("CPU time elapsed: %f seconds", cpu_elapsed);
-
+    double parallel_pi_3 = timed_pi(bm, "PARALLELISATION, 10000000 STEPS, 8 THREADS",
+                                    parallel_pi_calculation, 10000000, &fixed_elapsed);
+
+    // Adaptive Gauss-Kronrod on tasks, same tolerance the 10M-step sum reaches,
+    // floored a few ulps above pi: a tolerance the sum cannot resolve would split
+    // (and spawn tasks) down to max_depth everywhere
+    bench_stats stats;
+    adaptive_args adaptive = { pi_integrand, NULL, integrate_default_opts() };
+    adaptive.opts.abs_tol = fmax(fabs(parallel_pi_3 - M_PI), 4 * DBL_EPSILON * M_PI);
+    bench_run(bm, "ADAPTIVE PI", run_adaptive, &adaptive, NULL, &stats);
+    report_adaptive("ADAPTIVE GAUSS-KRONROD, PI, 8 THREADS", adaptive.result, M_PI, stats.median, fixed_elapsed);
+
+    // A peaked integrand, where uniform steps are wasted on the flat regions
+    double width = 1e-4;
+    double exact_peak = atan(0.7 / width) + atan(0.3 / width);
+    peak_args peak = { 10000000, width, 0.0 };
+    bench_run(bm, "FIXED-STEP PEAK", run_peak, &peak, NULL, &stats);
+    fixed_elapsed = stats.median;
+    printf("-------- FIXED-STEP PEAK, 10000000 STEPS, 8 THREADS ----------\n");
+    printf("Error: %.3e\n", fabs(peak.value - exact_peak));
+    printf("Wall time elapsed: %f seconds\n\n", fixed_elapsed);
+
+    adaptive.f = peak_integrand;
+    adaptive.ctx = &width;
+    adaptive.opts.abs_tol = 1e-10;
+    bench_run(bm, "ADAPTIVE PEAK", run_adaptive, &adaptive, NULL, &stats);
+    report_adaptive("ADAPTIVE GAUSS-KRONROD, PEAK, TOL 1e-10, 8 THREADS", adaptive.result, exact_peak, stats.median, fixed_elapsed);
+
+    bench_destroy(bm);
     return 0;
-}
\ No newline at end of file
+}
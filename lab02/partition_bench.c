@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include <unistd.h> // for usleep()
+
+#include "../common/bench.h"
+#include "../common/partition.h"
+
+#define NUM_THREADS 4
+#define SLEEP_N 20         // nest size for the sleep-bound body
+#define SLEEP_US 2000      // microseconds per inner iteration
+#define COMPUTE_N 2000     // nest size for the compute-bound body
+#define COMPUTE_WORK 50    // sqrt iterations per inner iteration
+#define CACHE_LINE 64
+
+typedef double (*loop_body)(long i, long j);
+
+// An irregular nest: for (i = 0; i < n; i++) for (j = 0; j < len[i]; j++)
+typedef struct {
+    long n;
+    long *len;        // inner trip count of row i
+    double *weight;   // len as the cost model for partition_weighted
+    int triangular;   // len[i] = n - i: partition_triangular applies and collapse(2) is legal
+} nest;
+
+// One slot per thread so the bookkeeping does not itself false-share. Each
+// thread sums its body results locally and publishes them to sink once.
+typedef struct {
+    double busy;
+    double sink;
+    long rows;
+} __attribute__((aligned(CACHE_LINE))) thread_busy;
+
+thread_busy busy[NUM_THREADS];
+bench *bm; // wall time of each variant; busy time stays per thread in busy[]
+
+double sleep_body(long i, long j) {
+    usleep(SLEEP_US);
+    return 0.0;
+}
+
+double compute_body(long i, long j) {
+    double x = i + j + 1.0;
+    for (int k = 0; k < COMPUTE_WORK; k++)
+        x = sqrt(x + k);
+    return x;
+}
+
+// team is the number of threads the variant actually ran with
+void report(const char *title, const nest *w, int team) {
+    double wall_elapsed = bench_stop(bm).median;
+    double max = 0.0, min = 1e30, total = 0.0;
+    long rows = 0;
+    printf("%-28s wall %9.6f s  busy per thread:", title, wall_elapsed);
+    for (int t = 0; t < team; t++) {
+        printf(" %.4f", busy[t].busy);
+        if (busy[t].busy > max) max = busy[t].busy;
+        if (busy[t].busy < min) min = busy[t].busy;
+        total += busy[t].busy;
+        rows += busy[t].rows;
+    }
+    printf("  imbalance (max/mean) %.3f\n", max / (total / team));
+    if (rows != w->n) fprintf(stderr, "%s: ran %ld rows of %ld\n", title, rows, w->n);
+}
+
+void reset_busy(void) {
+    for (int t = 0; t < NUM_THREADS; t++) busy[t].busy = busy[t].sink = 0.0, busy[t].rows = 0;
+}
+
+// Rows [begin, end) of the nest, timed into the calling thread's slot
+void run_rows(loop_body body, const nest *w, long begin, long end) {
+    double start = omp_get_wtime(), sum = 0.0;
+    for (long i = begin; i < end; i++)
+        for (long j = 0; j < w->len[i]; j++)
+            sum += body(i, j);
+    thread_busy *slot = &busy[omp_get_thread_num()];
+    slot->busy += omp_get_wtime() - start;
+    slot->sink += sum;
+    slot->rows += end - begin;
+}
+
+// Equal-cost bounds for parts threads: the closed form for the triangle,
+// the weights otherwise. spread is the heaviest part's cost over the mean.
+int partition_nest(const nest *w, int parts, long *bounds, double *spread) {
+    int rc = w->triangular ? partition_triangular(w->n, parts, bounds)
+                           : partition_weighted(w->weight, w->n, parts, bounds);
+    if (rc != 0) return rc;
+    double total = 0.0, max = 0.0;
+    for (int p = 0; p < parts; p++) {
+        double cost = 0.0;
+        for (long i = bounds[p]; i < bounds[p + 1]; i++) cost += w->weight[i];
+        if (cost > max) max = cost;
+        total += cost;
+    }
+    *spread = max / (total / parts);
+    return 0;
+}
+
+// The usual OpenMP schedules, picked at run time through schedule(runtime)
+void openmp_schedule(const char *title, omp_sched_t kind, int chunk, loop_body body, const nest *w) {
+    int team = 1;
+    reset_busy();
+    omp_set_schedule(kind, chunk);
+    bench_start(bm, title);
+    #pragma omp parallel
+    {
+        #pragma omp single nowait
+        team = omp_get_num_threads();
+        #pragma omp for schedule(runtime)
+        for (long i = 0; i < w->n; i++)
+            run_rows(body, w, i, i + 1);
+    }
+    report(title, w, team);
+}
+
+// collapse(2) needs an inner bound affine in i, so only the triangle qualifies
+void openmp_collapse(loop_body body, const nest *w) {
+    const char *title = "collapse(2)";
+    long n = w->n;
+    int team = 1;
+    reset_busy();
+    bench_start(bm, title);
+    #pragma omp parallel
+    {
+        double t0 = omp_get_wtime(), sum = 0.0;
+        #pragma omp single nowait
+        team = omp_get_num_threads();
+        #pragma omp for collapse(2) nowait
+        for (long i = 0; i < n; i++)
+            for (long j = 0; j < n - i; j++)
+                sum += body(i, j);
+        thread_busy *slot = &busy[omp_get_thread_num()];
+        slot->busy = omp_get_wtime() - t0;
+        slot->sink = sum;
+    }
+    busy[0].rows = n; // rows are split across threads here, count them once
+    report(title, w, team);
+}
+
+void equal_cost_partition(loop_body body, const nest *w) {
+    const char *title = "equal-cost partition";
+    long bounds[NUM_THREADS + 1];
+    int team = 1, failed = 0;
+    double spread = 0.0;
+
+    reset_busy();
+    bench_start(bm, title);
+    #pragma omp parallel
+    {
+        // sized for the team the runtime actually gave us
+        #pragma omp single
+        {
+            team = omp_get_num_threads();
+            failed = partition_nest(w, team, bounds, &spread) != 0;
+        }
+        int t = omp_get_thread_num();
+        if (!failed) run_rows(body, w, bounds[t], bounds[t + 1]);
+    }
+    if (failed) { bench_stop(bm); fprintf(stderr, "partitioning failed\n"); return; }
+    report(title, w, team);
+    printf("%-28s heaviest part %.3f of the mean cost\n", "", spread);
+}
+
+void equal_cost_stealing(loop_body body, const nest *w, long grain) {
+    const char *title = "equal-cost + stealing";
+    long bounds[NUM_THREADS + 1];
+    partition_steal *s = NULL;
+    int team = 1;
+    double spread = 0.0;
+
+    reset_busy();
+    bench_start(bm, title);
+    #pragma omp parallel
+    {
+        #pragma omp single
+        {
+            team = omp_get_num_threads();
+            if (partition_nest(w, team, bounds, &spread) == 0) s = partition_steal_create(bounds, team, grain);
+        }
+        int t = omp_get_thread_num();
+        long begin, end;
+        while (s && partition_steal_next(s, t, &begin, &end))
+            run_rows(body, w, begin, end);
+    }
+    if (!s) { bench_stop(bm); fprintf(stderr, "partition_steal_create failed\n"); return; }
+    report(title, w, team);
+    partition_steal_destroy(s);
+}
+
+void run_all(loop_body body, const nest *w) {
+    openmp_schedule("schedule(static)", omp_sched_static, 0, body, w);
+    openmp_schedule("schedule(static, 1)", omp_sched_static, 1, body, w);
+    openmp_schedule("schedule(dynamic, 1)", omp_sched_dynamic, 1, body, w);
+    openmp_schedule("schedule(guided, 1)", omp_sched_guided, 1, body, w);
+    if (w->triangular) openmp_collapse(body, w);
+    equal_cost_partition(body, w);
+    equal_cost_stealing(body, w, 1);
+}
+
+// The triangle, or a user-weighted nest whose last eighth of the rows each
+// cost 16 times the mean of the others, which defeats schedule(static)
+int make_nest(nest *w, long n, int triangular) {
+    w->n = n;
+    w->triangular = triangular;
+    w->len = malloc(sizeof(long) * n);
+    w->weight = malloc(sizeof(double) * n);
+    if (!w->len || !w->weight) { free(w->len); free(w->weight); return -1; }
+    for (long i = 0; i < n; i++) {
+        if (triangular) w->len[i] = n - i;
+        else w->len[i] = i >= n - n / 8 ? 2 * n : n / 8;
+        w->weight[i] = w->len[i];
+    }
+    return 0;
+}
+
+void free_nest(nest *w) {
+    free(w->len);
+    free(w->weight);
+}
+
+void run_case(const char *name, loop_body body, long n, int triangular) {
+    nest w;
+    if (make_nest(&w, n, triangular) != 0) { fprintf(stderr, "Memory allocation failed\n"); return; }
+    printf("\n-------- %s, %s NEST, %ld ROWS, %d THREADS ------------------\n",
+           name, triangular ? "TRIANGULAR" : "WEIGHTED", n, NUM_THREADS);
+    bench_start(bm, triangular ? "triangular" : "weighted");
+    run_all(body, &w);
+    bench_stop(bm);
+
+    double sink = 0.0;
+    for (int t = 0; t < NUM_THREADS; t++) sink += busy[t].sink;
+    if (sink < 0) printf("%f\n", sink); // keeps the bodies' results live
+    free_nest(&w);
+}
+
+int main(int argc, char **argv) {
+    omp_set_num_threads(NUM_THREADS); // always use 4 threads
+    omp_set_dynamic(0);
+    bm = bench_create("partition_bench");
+
+    bench_start(bm, "sleep");
+    run_case("SLEEP-BOUND BODY", sleep_body, SLEEP_N, 1);
+    run_case("SLEEP-BOUND BODY", sleep_body, SLEEP_N, 0);
+    bench_stop(bm);
+
+    bench_start(bm, "compute");
+    run_case("COMPUTE-BOUND BODY", compute_body, COMPUTE_N, 1);
+    run_case("COMPUTE-BOUND BODY", compute_body, COMPUTE_N, 0);
+    bench_stop(bm);
+
+    bench_destroy(bm);
+    return 0;
+}
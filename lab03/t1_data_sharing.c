@@ -3,9 +3,18 @@
 #include <time.h>
 #include <omp.h>
 
+#include "../common/bench.h"
+#include "../common/reduce.h"
+#include "../common/roofline.h"
+
 #define SIZE 134217728 // 0.5 GB of float32s
 
+roofline *roof; // NULL without a machine probe
+
 int main(int argc, char **argv) {
+    bench *bm = bench_create("t1_data_sharing");
+    roof = roofline_open(NULL);
+
     // WITH SHARED ARRAY AND SUM
     printf("-------- WITH DEFAULT(NONE), SHARED(ARRAY, SUM) ------------------\n");
     // generate random array
@@ -16,33 +25,56 @@ int main(int argc, char **argv) {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "shared_sum");
 
     #pragma omp parallel for default(none) shared(array, sum)
     for (int i = 0; i < SIZE; i++) {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "shared_sum", SIZE, omp_get_max_threads(), elapsed);
 
     // WITH SHARED ARRAY, REDUCTION FOR SUM
     printf("-------- WITH DEFAULT(NONE), SHARED(ARRAY), REDUCTION(+:SUM) ------------------\n");
     sum = 0.0;
-    start = omp_get_wtime();
+    bench_start(bm, "reduction");
 
     #pragma omp parallel for default(none) shared(array) reduction(+:sum)
     for (int i = 0; i < SIZE; i++) {
         sum += array[i];
     }
 
-    end = omp_get_wtime();
+    elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduction", SIZE, omp_get_max_threads(), elapsed);
+
+    // REPRODUCIBLE: same bits for any OMP_NUM_THREADS, so totals can be diffed across jobs
+    printf("-------- REPRODUCIBLE SUM, FIXED BLOCKS AND TREE ------------------\n");
+    bench_start(bm, "reduce_sum_repro");
+    sum = reduce_sum_repro(array, SIZE);
+    elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f (%a)\n", sum, sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduce_sum_repro", SIZE, omp_get_max_threads(), elapsed);
+
+    printf("-------- REPRODUCIBLE SUM, EXACT BINNED ------------------\n");
+    bench_start(bm, "reduce_sum_exact");
+    sum = reduce_sum_exact(array, SIZE);
+    elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f (%a)\n", sum, sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduce_sum_exact", SIZE, omp_get_max_threads(), elapsed);
     free(array);
 
+    bench_destroy(bm);
+    roofline_close(roof);
     return 0;
 }
\ No newline at end of file
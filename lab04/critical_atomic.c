@@ -1,9 +1,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
 #include <omp.h>
 
+#include "../common/bench.h"
+#include "../common/reduce.h"
+#include "../common/roofline.h"
+
 #define SIZE 134217728 // 0.5 GB of float32s
+#define MAX_THREADS 256 // partial slots; the partial sections run at most this many threads
+#define HISTOGRAM_BINS 10
+
+bench *bm; // one timer per calculation, written to BENCH_OUTPUT at exit
+roofline *roof; // NULL without a machine probe
 
 // int default_calculation() {
 //     printf("-------- DEFAULT CALCULATION ------------------\n");
@@ -114,17 +124,18 @@ int default_calculation() {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "default");
 
     #pragma omp parallel for
     for (int i = 0; i < SIZE; i++) {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "default", SIZE, omp_get_max_threads(), elapsed);
 
     free(array);
     return 0;
@@ -141,16 +152,17 @@ int unparallel_calculation() {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "unparallel");
 
     for (int i = 0; i < SIZE; i++) {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "unparallel", SIZE, 1, elapsed);
 
     free(array);
     return 0;
@@ -166,7 +178,7 @@ int critical_calculation() {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "critical");
 
     #pragma omp parallel for
     for (int i = 0; i < SIZE; i++) {
@@ -174,10 +186,11 @@ int critical_calculation() {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "critical", SIZE, omp_get_max_threads(), elapsed);
 
     free(array);
     return 0;
@@ -193,7 +206,7 @@ int atomic_calculation() {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "atomic");
 
     #pragma omp parallel for
     for (int i = 0; i < SIZE; i++) {
@@ -201,10 +214,11 @@ int atomic_calculation() {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "atomic", SIZE, omp_get_max_threads(), elapsed);
 
     free(array);
     return 0;
@@ -220,28 +234,189 @@ int reduction_calculation() {
     }
 
     double sum = 0.0;
-    double start = omp_get_wtime();
+    bench_start(bm, "reduction");
 
     #pragma omp parallel for reduction(+:sum)
     for (int i = 0; i < SIZE; i++) {
         sum += array[i];
     }
 
-    double end = omp_get_wtime();
+    double elapsed = bench_stop(bm).median;
 
     printf("Total: %.4f\n", sum);
-    printf("Elapsed time: %.6f seconds\n", end - start);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduction", SIZE, omp_get_max_threads(), elapsed);
+
+    free(array);
+    return 0;
+}
+
+// Each thread accumulates into its own slot of a shared array. The slots are
+// adjacent doubles, so every store invalidates the line in the other cores.
+int false_sharing_calculation() {
+    printf("-------- PER-THREAD PARTIALS, UNPADDED (FALSE SHARING) ------------------\n");
+    // generate random array
+    float *array = malloc(SIZE * sizeof(float));
+
+    for (int i = 0; i < SIZE; i++) {
+        array[i] = rand() / (float)(RAND_MAX + 1.0);
+    }
+
+    volatile double partial[MAX_THREADS] = {0}; // volatile so every add goes to memory
+    double sum = 0.0;
+    bench_start(bm, "false_sharing");
+
+    #pragma omp parallel num_threads(omp_get_max_threads() < MAX_THREADS ? omp_get_max_threads() : MAX_THREADS)
+    {
+        int t = omp_get_thread_num();
+        #pragma omp for
+        for (int i = 0; i < SIZE; i++) {
+            partial[t] += array[i];
+        }
+    }
+    for (int t = 0; t < MAX_THREADS; t++) sum += partial[t];
+
+    double elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f\n", sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "false_sharing", SIZE, omp_get_max_threads(), elapsed);
+
+    free(array);
+    return 0;
+}
+
+// Same as above but each slot sits on its own cache line
+int padded_partials_calculation() {
+    printf("-------- PER-THREAD PARTIALS, CACHE-LINE PADDED ------------------\n");
+    // generate random array
+    float *array = malloc(SIZE * sizeof(float));
+
+    for (int i = 0; i < SIZE; i++) {
+        array[i] = rand() / (float)(RAND_MAX + 1.0);
+    }
+
+    struct { volatile double value; char pad[REDUCE_CACHE_LINE - sizeof(double)]; }
+        __attribute__((aligned(REDUCE_CACHE_LINE))) partial[MAX_THREADS];
+    memset(partial, 0, sizeof(partial));
+    double sum = 0.0;
+    bench_start(bm, "padded_partials");
+
+    #pragma omp parallel num_threads(omp_get_max_threads() < MAX_THREADS ? omp_get_max_threads() : MAX_THREADS)
+    {
+        int t = omp_get_thread_num();
+        #pragma omp for
+        for (int i = 0; i < SIZE; i++) {
+            partial[t].value += array[i];
+        }
+    }
+    for (int t = 0; t < MAX_THREADS; t++) sum += partial[t].value;
+
+    double elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f\n", sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "padded_partials", SIZE, omp_get_max_threads(), elapsed);
+
+    free(array);
+    return 0;
+}
+
+int reduce_primitive_calculation() {
+    printf("-------- REDUCE PRIMITIVE (PADDED PARTIALS, TREE COMBINE, SIMD) ------------------\n");
+    // generate random array
+    float *array = malloc(SIZE * sizeof(float));
+
+    for (int i = 0; i < SIZE; i++) {
+        array[i] = rand() / (float)(RAND_MAX + 1.0);
+    }
+
+    bench_start(bm, "reduce_sum");
+    double sum = reduce_sum(array, SIZE);
+    double elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f\n", sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduce_sum", SIZE, omp_get_max_threads(), elapsed);
+
+    bench_start(bm, "reduce_argmin_argmax");
+    reduce_loc lo = reduce_argmin(array, SIZE);
+    reduce_loc hi = reduce_argmax(array, SIZE);
+    elapsed = bench_stop(bm).median;
+    printf("Min: %.9f at %ld, max: %.9f at %ld\n", lo.value, lo.index, hi.value, hi.index);
+    printf("Argmin + argmax time: %.6f seconds\n", elapsed);
+
+    long bins[HISTOGRAM_BINS];
+    bench_start(bm, "reduce_histogram");
+    reduce_histogram(array, SIZE, 0.0f, 1.0f, bins, HISTOGRAM_BINS);
+    elapsed = bench_stop(bm).median;
+    printf("Histogram:");
+    for (int b = 0; b < HISTOGRAM_BINS; b++) printf(" %ld", bins[b]);
+    printf("\nHistogram time: %.6f seconds\n", elapsed);
+
+    free(array);
+    return 0;
+}
+
+// Thread-count independent totals: the %a output is identical for any OMP_NUM_THREADS
+int reproducible_calculation() {
+    printf("-------- REPRODUCIBLE CALCULATION ------------------\n");
+    // generate random array
+    float *array = malloc(SIZE * sizeof(float));
+
+    for (int i = 0; i < SIZE; i++) {
+        array[i] = rand() / (float)(RAND_MAX + 1.0);
+    }
+
+    bench_start(bm, "reduce_sum_repro");
+    double sum = reduce_sum_repro(array, SIZE);
+    double elapsed = bench_stop(bm).median;
+
+    printf("Total: %.4f (%a)\n", sum, sum);
+    printf("Elapsed time: %.6f seconds\n", elapsed);
+    roofline_print_sum(stdout, roof, "reduce_sum_repro", SIZE, omp_get_max_threads(), elapsed);
+
+    bench_start(bm, "reduce_sum_exact");
+    sum = reduce_sum_exact(array, SIZE);
+    elapsed = bench_stop(bm).median;
+
+    printf("Exact total: %.4f (%a)\n", sum, sum);
+    printf("Exact elapsed time: %.6f seconds\n", elapsed);
 
     free(array);
     return 0;
 }
 
 int main(int argc, char **argv) {
+    // "./critical_atomic bench" also runs the false-sharing and reduce primitive variants,
+    // "./critical_atomic repro" replaces the reduction with the reproducible sums
+    int bench_mode = (argc > 1 && strcmp(argv[1], "bench") == 0);
+    int repro = (argc > 1 && strcmp(argv[1], "repro") == 0);
+
+    bm = bench_create("critical_atomic");
+    roof = roofline_open(NULL);
+
+    if (repro) {
+        reproducible_calculation();
+        bench_destroy(bm);
+        roofline_close(roof);
+        return 0;
+    }
+
     default_calculation();
     unparallel_calculation();
     critical_calculation();
     atomic_calculation();
     reduction_calculation();
 
+    if (bench_mode) {
+        false_sharing_calculation();
+        padded_partials_calculation();
+        reduce_primitive_calculation();
+        reproducible_calculation();
+    }
+
+    bench_destroy(bm);
+    roofline_close(roof);
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
-#include <time.h>
+
+#include "../common/bench.h"
+#include "../common/roofline.h"
 
 void matmul(float *A, float *B, float *C, int m, int n, int p) {
     // Optional: transpose B for better cache performance
@@ -25,6 +27,16 @@ void matmul(float *A, float *B, float *C, int m, int n, int p) {
     free(B_T);
 }
 
+typedef struct {
+    float *A, *B, *C;
+    int m, n, p;
+} matmul_args;
+
+void run_matmul(void *arg) {
+    matmul_args *a = arg;
+    matmul(a->A, a->B, a->C, a->m, a->n, a->p);
+}
+
 int main() {
     int m = 1024, n = 1024, p = 1024;
     float *A = malloc(sizeof(float) * m * n);
@@ -35,15 +47,30 @@ int main() {
     for (int i = 0; i < m * n; i++) A[i] = (float)rand() / RAND_MAX;
     for (int i = 0; i < n * p; i++) B[i] = (float)rand() / RAND_MAX;
 
-    double start = omp_get_wtime();
-    matmul(A, B, C, m, n, p);
-    double end = omp_get_wtime();
+    // each multiply takes around a second, so settle for a few samples
+    bench *bm = bench_create("matrix_mult");
+    bench_opts opts = bench_default_opts();
+    opts.warmup = 0; // the calibration call already warms the caches
+    opts.min_samples = 3;
+    opts.max_total = 0.0;
+    matmul_args args = { A, B, C, m, n, p };
+    bench_stats stats;
+    bench_run(bm, "matmul/1024", run_matmul, &args, &opts, &stats);
 
-    double elapsed = end - start;
+    double elapsed = stats.median;
     double flops = 2.0 * m * n * p / elapsed;
 
-    printf("Time: %.6f s\n", elapsed);
+    printf("Time: %.6f s (+/- %.6f, %d samples)\n", elapsed, stats.stddev, stats.samples);
     printf("FLOPS: %.2e\n", flops);
+    bench_destroy(bm);
+
+    // A, B and C once each; the transposed copy of B adds to the working set
+    roofline *roof = roofline_open(NULL);
+    roofline_work work = { 2.0 * m * n * p, 4.0 * ((double)m * n + (double)n * p + (double)m * p),
+                           sizeof(float) * ((size_t)m * n + 2 * (size_t)n * p + (size_t)m * p),
+                           omp_get_max_threads(), 0 };
+    roofline_print(stdout, roof, "matmul", &work, elapsed);
+    roofline_close(roof);
 
     free(A);
     free(B);
@@ -0,0 +1,123 @@
+/* numdiff.c - tolerance-aware diff for conv_test arrays and lab result lines.
+
+   Usage: numdiff [-a abs_tol] [-r rel_tol] [-q] expected actual
+
+   Both files are split into whitespace-separated tokens. Tokens that parse
+   as numbers must agree within abs_tol + rel_tol * max(|x|, |y|); any other
+   token must match exactly. The default abs_tol of 1e-3 accepts the last
+   digit differences that %.3f rounding produces. Exit status 0 when the files
+   agree, 1 when they differ, 2 on error. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+typedef struct {
+    char *data;
+    size_t len, pos;
+    int line;
+} token_stream;
+
+static int load(const char *path, token_stream *ts) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) { perror(path); return -1; }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    ts->data = malloc(size + 1);
+    if (!ts->data) { fclose(fp); return -1; }
+    ts->len = fread(ts->data, 1, size, fp);
+    ts->data[ts->len] = '\0';
+    ts->pos = 0;
+    ts->line = 1;
+    fclose(fp);
+    return 0;
+}
+
+/* Next token, NUL-terminated in place; NULL at end of file */
+static char *next_token(token_stream *ts, int *line) {
+    while (ts->pos < ts->len && isspace((unsigned char)ts->data[ts->pos])) {
+        if (ts->data[ts->pos] == '\n') ts->line++;
+        ts->pos++;
+    }
+    if (ts->pos >= ts->len) return NULL;
+    char *start = &ts->data[ts->pos];
+    *line = ts->line;
+    while (ts->pos < ts->len && !isspace((unsigned char)ts->data[ts->pos])) ts->pos++;
+    if (ts->pos < ts->len) {
+        if (ts->data[ts->pos] == '\n') ts->line++;
+        ts->data[ts->pos++] = '\0';
+    }
+    return start;
+}
+
+static int as_number(const char *tok, double *value) {
+    char *end;
+    *value = strtod(tok, &end);
+    return end != tok && *end == '\0';
+}
+
+int main(int argc, char **argv) {
+    double abs_tol = 1e-3, rel_tol = 0.0;
+    int quiet = 0, c;
+    while ((c = getopt(argc, argv, "a:r:q")) != -1) {
+        switch (c) {
+            case 'a': abs_tol = atof(optarg); break;
+            case 'r': rel_tol = atof(optarg); break;
+            case 'q': quiet = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-a abs_tol] [-r rel_tol] [-q] expected actual\n", argv[0]);
+                return 2;
+        }
+    }
+    if (argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-a abs_tol] [-r rel_tol] [-q] expected actual\n", argv[0]);
+        return 2;
+    }
+
+    token_stream a, b;
+    if (load(argv[optind], &a) != 0 || load(argv[optind + 1], &b) != 0) return 2;
+
+    long tokens = 0, mismatches = 0;
+    double max_diff = 0.0;
+    int line_a = 0, line_b = 0;
+    for (;;) {
+        char *x = next_token(&a, &line_a);
+        char *y = next_token(&b, &line_b);
+        if (!x || !y) {
+            if (x || y) {
+                if (!quiet) fprintf(stderr, "%s: %s ends early\n", argv[0], x ? argv[optind + 1] : argv[optind]);
+                mismatches++;
+            }
+            break;
+        }
+        tokens++;
+
+        double u, v;
+        int ok;
+        if (as_number(x, &u) && as_number(y, &v)) {
+            double d = fabs(u - v);
+            if (d > max_diff) max_diff = d;
+            /* small slack so a difference of exactly abs_tol is not lost to rounding */
+            ok = d <= abs_tol * (1 + 1e-9) + rel_tol * fmax(fabs(u), fabs(v));
+        } else {
+            ok = strcmp(x, y) == 0;
+        }
+        if (!ok) {
+            if (!quiet && mismatches < 5)
+                fprintf(stderr, "%s: line %d: expected '%s', got '%s' (line %d)\n",
+                        argv[0], line_a, x, y, line_b);
+            mismatches++;
+        }
+    }
+
+    if (!quiet)
+        fprintf(stderr, "%s: %ld tokens, %ld mismatches, max numeric difference %.3g\n",
+                argv[0], tokens, mismatches, max_diff);
+    free(a.data);
+    free(b.data);
+    return mismatches ? 1 : 0;
+}
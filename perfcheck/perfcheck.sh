@@ -0,0 +1,279 @@
+#!/bin/bash
+# perfcheck.sh - golden-output and timing regression suite for conv_test and
+# the lab kernels. Normally run through "make perfcheck" (here or in
+# assignment1).
+#
+#   ./perfcheck.sh [check]   compare outputs to golden/ and timings to the baseline
+#   ./perfcheck.sh baseline  record this machine's timing baseline
+#   ./perfcheck.sh golden    regenerate golden/ from the current build
+#
+# Every program is run with BENCH_OUTPUT set, so the timings compared are the
+# medians the bench library already collects. The first check on a machine
+# without a baseline records one instead of comparing.
+#
+# Environment:
+#   PERF_TOLERANCE  allowed slowdown of a median, in percent (default 25)
+#   PERF_MIN_TIME   medians below this many seconds are too noisy to compare (default 1e-4)
+#   PERF_BASELINE   baseline file (default baselines/<hostname>.csv)
+#   PERF_RETRIES    reruns of a slow suite before it counts as slower (default 2)
+#   PERFCHECK_LABS  set to 0 to check conv_test only
+
+set -u
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(dirname "$HERE")
+CONV_DIR=$ROOT/assignment1
+WORK=$HERE/work
+NUMDIFF=$HERE/numdiff
+CONV=$CONV_DIR/conv_test
+
+MODE=${1:-check}
+PERF_TOLERANCE=${PERF_TOLERANCE:-25}
+PERF_MIN_TIME=${PERF_MIN_TIME:-1e-4}
+PERF_BASELINE=${PERF_BASELINE:-$HERE/baselines/$(hostname -s).csv}
+PERF_RETRIES=${PERF_RETRIES:-2}
+PERFCHECK_LABS=${PERFCHECK_LABS:-1}
+
+case $MODE in
+    check|baseline|golden) ;;
+    *) echo "Usage: $0 [check|baseline|golden]" >&2; exit 2 ;;
+esac
+
+failures=0
+
+fail() {
+    echo "FAIL  $*"
+    failures=$((failures + 1))
+}
+
+regenerated=" "
+
+# compare <name> <golden> <actual> [numdiff options]
+# In golden mode the first output for each file under golden/ replaces it and
+# later outputs are compared against that one.
+compare() {
+    local name=$1 golden=$2 actual=$3
+    shift 3
+    if [ "$MODE" = golden ] && [ "${golden#$HERE/golden/}" != "$golden" ] &&
+       [ "${regenerated#* $golden }" = "$regenerated" ]; then
+        cp "$actual" "$golden"
+        regenerated="$regenerated$golden "
+        echo "gold  $name"
+    elif [ ! -f "$golden" ]; then
+        fail "$name: no golden file $golden"
+    elif "$NUMDIFF" "$@" "$golden" "$actual" 2> "$actual.diff"; then
+        echo "ok    $name"
+    else
+        fail "$name"
+        sed 's/^/      /' "$actual.diff"
+    fi
+}
+
+# timed <suite> <command...>: run with BENCH_OUTPUT and file the medians under
+# <suite>, so the same program run on different inputs stays distinguishable.
+# The command is kept so that a suite that looks slower can be rerun.
+timed() {
+    local suite=$1
+    shift
+    printf '%q ' "$@" > "$WORK/cmd/$suite"
+    local csv=$WORK/csv/$suite.csv
+    rm -f "$csv"
+    BENCH_OUTPUT=$csv "$@" > "$WORK/log/$suite.out" 2> "$WORK/log/$suite.err"
+    local status=$?
+    if [ $status -ne 0 ]; then
+        fail "$suite: '$*' exited with status $status"
+        sed 's/^/      /' "$WORK/log/$suite.err"
+        return 1
+    fi
+    [ -f "$csv" ] && tail -n +2 "$csv" | sed "s/^\"[^\"]*\"/\"$suite\"/" >> "$WORK/results.csv"
+    return 0
+}
+
+# ---------------------------------------------------------------- setup
+
+rm -rf "$WORK"
+mkdir -p "$WORK/cmd" "$WORK/csv" "$WORK/log" "$WORK/out" "$WORK/labs"
+echo "suite,name,samples,rejected,calls_per_sample,median,mean,stddev,min,max,cpu,caller_cpu" > "$WORK/results.csv"
+
+make -s -C "$CONV_DIR" conv_test mconv_bench || { echo "FAIL  building conv_test"; exit 1; }
+
+# ---------------------------------------------------------------- conv_test results
+
+# the reference pairs shipped with the assignment, through every engine that accepts them
+for i in 0 1 2 3; do
+    for engine in naive sparse auto; do
+        case=conv_f${i}_g${i}_$engine
+        out=$WORK/out/$case.txt
+        timed "$case" "$CONV" -f "$CONV_DIR/f$i.txt" -g "$CONV_DIR/g$i.txt" -o "$out" --engine $engine &&
+            compare "$case" "$CONV_DIR/o$i.txt" "$out"
+    done
+done
+
+# kernels that steer the specialised engines, on the 100x100 reference image
+for spec in box5:naive box5:sat box5:auto cross9:naive cross9:sparse cross9:auto; do
+    kernel=${spec%%:*}
+    engine=${spec#*:}
+    case=conv_f3_${kernel}_$engine
+    out=$WORK/out/$case.txt
+    timed "$case" "$CONV" -f "$CONV_DIR/f3.txt" -g "$HERE/inputs/$kernel.txt" -o "$out" --engine $engine &&
+        compare "$case" "$HERE/golden/conv_f3_$kernel.txt" "$out"
+done
+
+case=conv_f3_box5_iters4
+out=$WORK/out/$case.txt
+timed "$case" "$CONV" -f "$CONV_DIR/f3.txt" -g "$HERE/inputs/box5.txt" -o "$out" --iters 4 &&
+    compare "$case" "$HERE/golden/$case.txt" "$out"
+
+# 16-bit storage rounds f and out, so it gets the tolerance of its format
+for spec in fp16:0.01 bf16:0.05; do
+    storage=${spec%%:*}
+    case=conv_f3_g3_$storage
+    out=$WORK/out/$case.txt
+    timed "$case" "$CONV" -f "$CONV_DIR/f3.txt" -g "$CONV_DIR/g3.txt" -o "$out" --storage $storage &&
+        compare "$case" "$CONV_DIR/o3.txt" "$out" -a ${spec#*:}
+done
+
+# 8-bit quantised path, within about one output step (scale ~0.05 here)
+case=conv_f3_g3_int8
+out=$WORK/out/$case.txt
+timed "$case" "$CONV" -f "$CONV_DIR/f3.txt" -g "$CONV_DIR/g3.txt" -o "$out" --quant int8 &&
+    compare "$case" "$CONV_DIR/o3.txt" "$out" -a 0.1
+
+# 3D volume and kernel; blocked and naive sums are identical, auto runs blocked
+for engine in naive auto; do
+    case=conv_vol_k333_$engine
+    out=$WORK/out/$case.txt
+    timed "$case" "$CONV" -f "$HERE/inputs/vol6x10x12.txt" -g "$HERE/inputs/k333.txt" -o "$out" --engine $engine &&
+        compare "$case" "$HERE/golden/conv_vol_k333.txt" "$out"
+done
+
+# ---------------------------------------------------------------- conv_test timings
+
+# large generated image, long enough per call for stable medians
+timed conv_1000_g3_naive "$CONV" -H 1000 -W 1000 -g "$CONV_DIR/g3.txt" --engine naive
+timed conv_1000_cross9_naive "$CONV" -H 1000 -W 1000 -g "$HERE/inputs/cross9.txt" --engine naive
+timed conv_1000_cross9_sparse "$CONV" -H 1000 -W 1000 -g "$HERE/inputs/cross9.txt" --engine sparse
+timed conv_1000_g3_fp16 "$CONV" -H 1000 -W 1000 -g "$CONV_DIR/g3.txt" --storage fp16
+timed conv_1000_g3_bf16 "$CONV" -H 1000 -W 1000 -g "$CONV_DIR/g3.txt" --storage bf16
+timed conv_1000_g3_int8 "$CONV" -H 1000 -W 1000 -g "$CONV_DIR/g3.txt" --quant int8
+timed conv_1000_box31_sat "$CONV" -H 1000 -W 1000 -g "$HERE/inputs/box31.txt" --engine sat
+timed conv_1000_g0_iters8 "$CONV" -H 1000 -W 1000 -g "$CONV_DIR/g0.txt" --iters 8
+timed conv_vol64x256x256_k333 "$CONV" -D 64 -H 256 -W 256 --kD 3 --kH 3 --kW 3
+
+# multi-channel layouts; the sweep checks every layout against the double engine
+timed mconv "$CONV_DIR/mconv_bench" --quick && echo "ok    mconv"
+
+# ---------------------------------------------------------------- lab kernels
+
+# result lines worth comparing; data-race sections print arbitrary totals
+lab_results() {
+    awk '/^--------/ { skip = /DATA RACE|SHARED\(ARRAY, SUM\)/; next }
+         skip { next }
+         /^(Size of array|Dot product result|Result|Total|Exact total|Min|Histogram):/ { print; next }
+         /^(pi|value)=/ { sub(/=/, "= "); print; next }
+         /^Fast:/ { sub(/.*, result /, "Fast result: "); print }' "$1"
+}
+
+# lab <name> <directory> <sources> <compiler flags> [-- <arguments>]
+lab() {
+    local name=$1 dir=$2 sources=$3 flags=$4
+    shift 4
+    [ "${1:-}" = "--" ] && shift
+    local exe=$WORK/labs/$name
+    if ! (cd "$ROOT/$dir" && gcc $sources $flags -o "$exe" -lm); then
+        fail "$name: build failed"
+        return
+    fi
+    timed "$name" "$exe" "$@" || return
+    if [ -f "$HERE/golden/$name.txt" ] || [ "$MODE" = golden ]; then
+        lab_results "$WORK/log/$name.out" > "$WORK/out/$name.txt"
+        [ -s "$WORK/out/$name.txt" ] &&
+            compare "$name" "$HERE/golden/$name.txt" "$WORK/out/$name.txt" -a 0 -r 1e-9
+    else
+        echo "ok    $name (timing only)"
+    fi
+}
+
+if [ "$PERFCHECK_LABS" != 0 ]; then
+    lab dot_product lab01 "dot_product.c ../common/bench.c ../common/roofline.c" "-fopenmp -O3"
+    if grep -qw avx512f /proc/cpuinfo 2> /dev/null; then
+        lab dot_product_intrinsics lab01 "dot_product_intrinsics.c ../common/bench.c ../common/roofline.c" "-O3 -mavx512f"
+    fi
+    lab num_integration lab02 "num_integration.c ../common/integrate.c ../common/bench.c" "-fopenmp -O3"
+    lab partition_bench lab02 "partition_bench.c ../common/partition.c ../common/bench.c" "-fopenmp -O3"
+    lab usleep lab02 "usleep.c ../common/bench.c" "-fopenmp -O3"
+    lab t1_data_sharing lab03 "t1_data_sharing.c ../common/reduce.c ../common/bench.c ../common/roofline.c" "-fopenmp -O3"
+    lab critical_atomic lab04 "critical_atomic.c ../common/reduce.c ../common/bench.c ../common/roofline.c" "-fopenmp -O3" -- bench
+    lab matrix_mult lab04 "matrix_mult.c ../common/bench.c ../common/roofline.c" "-fopenmp -O3"
+fi
+
+# ---------------------------------------------------------------- timings vs baseline
+
+# Report each median in results.csv (the best one when a suite was rerun)
+# against the baseline; suites with slowdowns are listed in slow.txt.
+compare_timings() {
+    # rows are "suite","name",samples,rejected,calls_per_sample,median,...
+    awk -v tol="$PERF_TOLERANCE" -v min_time="$PERF_MIN_TIME" -v slow_list="$WORK/slow.txt" '
+        function parse(line) {
+            if (!match(line, /^"[^"]*","[^"]*",/)) return 0
+            key = substr(line, 1, RLENGTH - 1)
+            split(substr(line, RLENGTH + 1), field, ",")
+            median = field[4] + 0
+            return 1
+        }
+        FNR == 1 { next }
+        NR == FNR { if (parse($0)) base[key] = median; next }
+        parse($0) {
+            if (!(key in best)) { order[n++] = key; best[key] = median }
+            else if (median < best[key]) best[key] = median
+        }
+        END {
+            printf "" > slow_list
+            for (i = 0; i < n; i++) {
+                key = order[i]
+                median = best[key]
+                label = key
+                gsub(/"/, "", label)
+                sub(/,/, "/", label)
+                if (!(key in base)) { printf "new   %s %.3es\n", label, median; continue }
+                if (base[key] < min_time && median < min_time) continue
+                change = 100 * (median / base[key] - 1)
+                if (change > tol) {
+                    printf "SLOW  %s %.3es -> %.3es (%+.1f%%)\n", label, base[key], median, change
+                    suite = label
+                    sub(/\/.*/, "", suite)
+                    if (!(suite in listed)) print suite > slow_list
+                    listed[suite] = 1
+                    slow++
+                } else if (change < -tol) {
+                    printf "fast  %s %.3es -> %.3es (%+.1f%%)\n", label, base[key], median, change
+                }
+                compared++
+            }
+            printf "%d timings compared, %d slower than the baseline\n", compared, slow
+            exit slow > 0
+        }' "$PERF_BASELINE" "$WORK/results.csv"
+}
+
+if [ "$MODE" = baseline ] || { [ "$MODE" = check ] && [ ! -f "$PERF_BASELINE" ]; }; then
+    mkdir -p "$(dirname "$PERF_BASELINE")"
+    cp "$WORK/results.csv" "$PERF_BASELINE"
+    echo "Recorded timing baseline $PERF_BASELINE"
+elif [ "$MODE" = check ]; then
+    echo "Timings against $PERF_BASELINE (tolerance $PERF_TOLERANCE%, ignoring medians below $PERF_MIN_TIME s)"
+    # a suite that looks slower is rerun and judged on its best median, so one
+    # noisy run does not fail the check
+    for retry in $(seq "$PERF_RETRIES"); do
+        compare_timings > /dev/null && break
+        for suite in $(cat "$WORK/slow.txt"); do
+            eval "timed $suite $(cat "$WORK/cmd/$suite")"
+        done
+    done
+    compare_timings || failures=$((failures + 1))
+fi
+
+if [ $failures -gt 0 ]; then
+    echo "perfcheck: $failures failure(s), logs in $WORK"
+    exit 1
+fi
+echo "perfcheck: all checks passed"